@@ -0,0 +1,102 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+// How fast corpora are read back from json. A corpus is repeated until it
+// is as large as asked (hundreds of MiB, like those of big libraries), then
+// written and read back a few times, and the best times are reported.
+
+#include <smeagle/corpora.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+  using clock_type = std::chrono::steady_clock;
+
+  double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+  }
+
+  int usage(char const *program) {
+    std::cerr << "usage: " << program << " <corpus.json> [--size MiB] [--repeat N]\n"
+              << "  Write the corpus of a library first, with Smeagle -l <library>\n";
+    return 1;
+  }
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string input;
+  double size_mib = 256;
+  int repeat = 3;
+  for (int i = 1; i < argc; i++) {
+    std::string const arg = argv[i];
+    if (arg == "--size" && i + 1 < argc) {
+      size_mib = std::atof(argv[++i]);
+    } else if (arg == "--repeat" && i + 1 < argc) {
+      repeat = std::max(1, std::atoi(argv[++i]));
+    } else if (input.empty() && arg[0] != '-') {
+      input = arg;
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (input.empty()) return usage(argv[0]);
+
+  auto const seed = smeagle::Corpus::fromJsonFile(input);
+  if (seed.getFunctions().empty() && seed.getVariables().empty()) {
+    std::cerr << input << " has no functions or variables to repeat\n";
+    return 1;
+  }
+
+  // Repeat the locations of the seed until the corpus is large enough
+  auto const path = std::filesystem::temp_directory_path()
+                    / ("smeagle-benchmark-" + std::to_string(getpid()) + ".json");
+  auto const target = static_cast<std::streamoff>(size_mib * (1 << 20));
+  {
+    std::ofstream out(path);
+    smeagle::CorpusWriter writer(out, seed.getLibrary());
+    do {
+      writer.addLocations(seed);
+    } while (out.tellp() < target);
+    writer.finish(seed);
+  }
+  auto const bytes = std::filesystem::file_size(path);
+  auto const mib = static_cast<double>(bytes) / (1 << 20);
+
+  double best_load = 0, best_write = 0;
+  size_t functions = 0, variables = 0;
+  for (int i = 0; i < repeat; i++) {
+    auto start = clock_type::now();
+    auto const corpus = smeagle::Corpus::fromJsonFile(path);
+    auto const load = seconds_since(start);
+    functions = corpus.getFunctions().size();
+    variables = corpus.getVariables().size();
+
+    start = clock_type::now();
+    {
+      std::ofstream out("/dev/null");
+      corpus.toJson(out);
+    }
+    auto const write = seconds_since(start);
+
+    best_load = i == 0 ? load : std::min(best_load, load);
+    best_write = i == 0 ? write : std::min(best_write, write);
+  }
+  std::filesystem::remove(path);
+
+  std::printf("corpus: %.1f MiB, %zu functions, %zu variables\n", mib, functions, variables);
+  std::printf("load:   %.3f s, %.0f MiB/s, %.0f functions/s\n", best_load, mib / best_load,
+              static_cast<double>(functions) / best_load);
+  std::printf("write:  %.3f s, %.0f MiB/s\n", best_write, mib / best_write);
+  return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+ * Spack Project Developers. See the top-level COPYRIGHT file for details.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR MIT)
+ */
+
+/*
+ * A C interface to Smeagle, for tools that parse libraries in-process.
+ *
+ * Everything is reached through opaque handles: a session opens one
+ * library, a corpus is what parsing it found, and a function belongs to a
+ * corpus. A corpus keeps the library of its session open, so they can be
+ * freed in either order; functions are borrowed from their corpus.
+ *
+ * Strings are copied into buffers of the caller, like snprintf: at most
+ * size - 1 bytes and a terminating zero are written, and the full length is
+ * returned, so a call with a NULL buffer and size 0 asks for the length.
+ * Nothing returned by this interface has to be freed by the caller, other
+ * than sessions and corpora.
+ *
+ * Functions that can fail return a smeagle_status, and the reason can be
+ * read with smeagle_last_error on the same thread.
+ */
+
+#ifndef SMEAGLE_C_H
+#define SMEAGLE_C_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented when functions are added, existing ones never change */
+#define SMEAGLE_C_API_VERSION 1
+
+typedef struct smeagle_session smeagle_session;
+typedef struct smeagle_corpus smeagle_corpus;
+typedef struct smeagle_function smeagle_function;
+
+typedef enum {
+  SMEAGLE_OK = 0,
+  SMEAGLE_ERROR = 1,         /* the library could not be opened or parsed */
+  SMEAGLE_INVALID_ARGUMENT = 2
+} smeagle_status;
+
+/* What to read of a parameter (or of the return value) */
+typedef enum {
+  SMEAGLE_PARAMETER_NAME = 0,
+  SMEAGLE_PARAMETER_TYPE = 1,
+  SMEAGLE_PARAMETER_CLASS = 2,
+  SMEAGLE_PARAMETER_DIRECTION = 3,
+  SMEAGLE_PARAMETER_LOCATION = 4
+} smeagle_parameter_field;
+
+/* The index of the return value, for the parameter functions */
+#define SMEAGLE_RETURN_VALUE ((size_t)-1)
+
+/* The SMEAGLE_C_API_VERSION the library was built with */
+int smeagle_api_version(void);
+
+/* Why the last call on this thread failed (empty if it did not) */
+size_t smeagle_last_error(char *buffer, size_t size);
+
+/* Open a library, which is only read once it is parsed */
+smeagle_status smeagle_session_open(char const *library, smeagle_session **session);
+void smeagle_session_close(smeagle_session *session);
+
+/* Parse the library of a session into a new corpus */
+smeagle_status smeagle_parse(smeagle_session *session, smeagle_corpus **corpus);
+void smeagle_corpus_free(smeagle_corpus *corpus);
+
+/* The corpus as json, like the command line client writes it (0 and the
+   last error if it could not be written) */
+size_t smeagle_corpus_json(smeagle_corpus const *corpus, char *buffer, size_t size);
+
+/* Did parsing stop before all symbols were seen? (0 or 1) */
+int smeagle_corpus_truncated(smeagle_corpus const *corpus);
+
+/* The functions of a corpus, by index or one after the other (NULL starts, NULL ends) */
+size_t smeagle_corpus_function_count(smeagle_corpus const *corpus);
+smeagle_function const *smeagle_corpus_function(smeagle_corpus const *corpus, size_t index);
+smeagle_function const *smeagle_corpus_next_function(smeagle_corpus const *corpus,
+                                                     smeagle_function const *previous);
+
+/* The function with this mangled name, or NULL */
+smeagle_function const *smeagle_corpus_find_function(smeagle_corpus const *corpus,
+                                                     char const *name);
+
+size_t smeagle_function_name(smeagle_function const *function, char *buffer, size_t size);
+size_t smeagle_function_parameter_count(smeagle_function const *function);
+
+/* A field of parameter index (or SMEAGLE_RETURN_VALUE), empty if there is no such parameter */
+size_t smeagle_function_parameter(smeagle_function const *function, size_t index,
+                                  smeagle_parameter_field field, char *buffer, size_t size);
+
+/* The size in bytes of parameter index (or SMEAGLE_RETURN_VALUE), 0 if there is none */
+size_t smeagle_function_parameter_size(smeagle_function const *function, size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMEAGLE_C_H */
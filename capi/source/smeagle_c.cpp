@@ -0,0 +1,175 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle_c.h"
+
+#include <smeagle/smeagle.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+
+// A corpus refers to the Dyninst types of its library, so it shares the
+// library with its session and the last of the two to go closes it
+struct smeagle_session {
+  std::shared_ptr<smeagle::Smeagle> smeagle;
+};
+
+struct smeagle_corpus {
+  std::shared_ptr<smeagle::Smeagle> smeagle;  // destroyed after the corpus
+  smeagle::Corpus corpus;
+};
+
+namespace {
+  thread_local std::string last_error;
+
+  smeagle::abi_function_description const *unwrap(smeagle_function const *function) {
+    return reinterpret_cast<smeagle::abi_function_description const *>(function);
+  }
+
+  smeagle_function const *wrap(smeagle::abi_function_description const *function) {
+    return reinterpret_cast<smeagle_function const *>(function);
+  }
+
+  // Copy like snprintf, returning the full length
+  size_t copy(std::string const &value, char *buffer, size_t size) {
+    if (buffer && size > 0) {
+      auto const n = std::min(value.size(), size - 1);
+      std::memcpy(buffer, value.data(), n);
+      buffer[n] = '\0';
+    }
+    return value.size();
+  }
+
+  smeagle_status fail(smeagle_status status, std::string reason) {
+    last_error = std::move(reason);
+    return status;
+  }
+
+  smeagle::parameter const *find_parameter(smeagle_function const *function, size_t index) {
+    if (!function) return nullptr;
+    auto const &f = *unwrap(function);
+    if (index == SMEAGLE_RETURN_VALUE) return &f.return_value;
+    return index < f.parameters.size() ? &f.parameters[index] : nullptr;
+  }
+}  // namespace
+
+extern "C" {
+
+int smeagle_api_version(void) { return SMEAGLE_C_API_VERSION; }
+
+size_t smeagle_last_error(char *buffer, size_t size) { return copy(last_error, buffer, size); }
+
+smeagle_status smeagle_session_open(char const *library, smeagle_session **session) {
+  last_error.clear();
+  if (!library || !session) return fail(SMEAGLE_INVALID_ARGUMENT, "No library or session given");
+  try {
+    auto smeagle = std::shared_ptr<smeagle::Smeagle>(new smeagle::Smeagle(library),
+                                                     [](smeagle::Smeagle *s) {
+                                                       s->close();
+                                                       delete s;
+                                                     });
+    *session = new smeagle_session{std::move(smeagle)};
+    return SMEAGLE_OK;
+  } catch (std::exception const &e) {
+    *session = nullptr;
+    return fail(SMEAGLE_ERROR, e.what());
+  }
+}
+
+void smeagle_session_close(smeagle_session *session) { delete session; }
+
+smeagle_status smeagle_parse(smeagle_session *session, smeagle_corpus **corpus) {
+  last_error.clear();
+  if (!session || !corpus) return fail(SMEAGLE_INVALID_ARGUMENT, "No session or corpus given");
+  *corpus = nullptr;
+  try {
+    *corpus = new smeagle_corpus{session->smeagle, session->smeagle->parse()};
+    return SMEAGLE_OK;
+  } catch (std::exception const &e) {
+    return fail(SMEAGLE_ERROR, e.what());
+  }
+}
+
+void smeagle_corpus_free(smeagle_corpus *corpus) { delete corpus; }
+
+size_t smeagle_corpus_json(smeagle_corpus const *corpus, char *buffer, size_t size) {
+  last_error.clear();
+  if (!corpus) return copy({}, buffer, size);
+  try {
+    std::ostringstream out;
+    corpus->corpus.toJson(out);
+    return copy(out.str(), buffer, size);
+  } catch (std::exception const &e) {
+    fail(SMEAGLE_ERROR, e.what());
+    return copy({}, buffer, size);
+  }
+}
+
+int smeagle_corpus_truncated(smeagle_corpus const *corpus) {
+  return corpus && corpus->corpus.isTruncated() ? 1 : 0;
+}
+
+size_t smeagle_corpus_function_count(smeagle_corpus const *corpus) {
+  return corpus ? corpus->corpus.getFunctions().size() : 0;
+}
+
+smeagle_function const *smeagle_corpus_function(smeagle_corpus const *corpus, size_t index) {
+  if (!corpus || index >= corpus->corpus.getFunctions().size()) return nullptr;
+  return wrap(&corpus->corpus.getFunctions()[index]);
+}
+
+smeagle_function const *smeagle_corpus_next_function(smeagle_corpus const *corpus,
+                                                     smeagle_function const *previous) {
+  if (!corpus) return nullptr;
+  auto const &functions = corpus->corpus.getFunctions();
+  auto const next = previous ? static_cast<size_t>(unwrap(previous) - functions.data()) + 1 : 0;
+  return next < functions.size() ? wrap(&functions[next]) : nullptr;
+}
+
+smeagle_function const *smeagle_corpus_find_function(smeagle_corpus const *corpus,
+                                                     char const *name) {
+  if (!corpus || !name) return nullptr;
+  for (auto const &f : corpus->corpus.getFunctions()) {
+    if (f.function_name == name) return wrap(&f);
+  }
+  return nullptr;
+}
+
+size_t smeagle_function_name(smeagle_function const *function, char *buffer, size_t size) {
+  return copy(function ? unwrap(function)->function_name : std::string(), buffer, size);
+}
+
+size_t smeagle_function_parameter_count(smeagle_function const *function) {
+  return function ? unwrap(function)->parameters.size() : 0;
+}
+
+size_t smeagle_function_parameter(smeagle_function const *function, size_t index,
+                                  smeagle_parameter_field field, char *buffer, size_t size) {
+  auto const *p = find_parameter(function, index);
+  if (!p) return copy({}, buffer, size);
+  switch (field) {
+    case SMEAGLE_PARAMETER_NAME:
+      return copy(p->name(), buffer, size);
+    case SMEAGLE_PARAMETER_TYPE:
+      return copy(p->type_name(), buffer, size);
+    case SMEAGLE_PARAMETER_CLASS:
+      return copy(p->class_name(), buffer, size);
+    case SMEAGLE_PARAMETER_DIRECTION:
+      return copy(p->direction(), buffer, size);
+    case SMEAGLE_PARAMETER_LOCATION:
+      return copy(p->location(), buffer, size);
+  }
+  return copy({}, buffer, size);
+}
+
+size_t smeagle_function_parameter_size(smeagle_function const *function, size_t index) {
+  auto const *p = find_parameter(function, index);
+  return p ? p->size_in_bytes() : 0;
+}
+
+}  // extern "C"
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+ * Spack Project Developers. See the top-level COPYRIGHT file for details.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR MIT)
+ */
+
+/* Parses the library given as its argument (the C interface itself) */
+
+#include <smeagle_c.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition)                                            \
+  do {                                                              \
+    if (!(condition)) {                                             \
+      fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+      failures++;                                                   \
+    }                                                               \
+  } while (0)
+
+int main(int argc, char **argv) {
+  smeagle_session *session = NULL;
+  smeagle_corpus *corpus = NULL;
+  smeagle_function const *function;
+  char name[4096];
+  char small[4];
+  size_t count = 0;
+  size_t length;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <library>\n", argv[0]);
+    return 2;
+  }
+
+  CHECK(smeagle_api_version() == SMEAGLE_C_API_VERSION);
+
+  /* Failures are reported with a status and a reason */
+  CHECK(smeagle_session_open(NULL, &session) == SMEAGLE_INVALID_ARGUMENT);
+  CHECK(smeagle_session_open("/nonexistent/libnothing.so", &session) == SMEAGLE_ERROR);
+  CHECK(session == NULL);
+  CHECK(smeagle_last_error(NULL, 0) > 0);
+
+  CHECK(smeagle_session_open(argv[1], &session) == SMEAGLE_OK);
+  CHECK(smeagle_last_error(NULL, 0) == 0);
+  CHECK(smeagle_parse(session, &corpus) == SMEAGLE_OK);
+  if (!corpus) return 1;
+  CHECK(!smeagle_corpus_truncated(corpus));
+
+  /* The iterator sees the same functions as the index */
+  for (function = smeagle_corpus_next_function(corpus, NULL); function;
+       function = smeagle_corpus_next_function(corpus, function)) {
+    CHECK(function == smeagle_corpus_function(corpus, count));
+    length = smeagle_function_name(function, name, sizeof name);
+    CHECK(length < sizeof name && strlen(name) == length);
+    CHECK(smeagle_corpus_find_function(corpus, name) != NULL);
+    CHECK(smeagle_function_parameter(function, smeagle_function_parameter_count(function),
+                                     SMEAGLE_PARAMETER_NAME, name, sizeof name)
+          == 0);
+    count++;
+  }
+  CHECK(count == smeagle_corpus_function_count(corpus));
+  CHECK(smeagle_corpus_function(corpus, count) == NULL);
+  CHECK(smeagle_corpus_find_function(corpus, "no such function") == NULL);
+
+  /* Strings are cut to the buffer, and their full length returned */
+  length = smeagle_corpus_json(corpus, NULL, 0);
+  CHECK(length > sizeof small);
+  CHECK(smeagle_corpus_json(corpus, small, sizeof small) == length);
+  CHECK(strlen(small) == sizeof small - 1);
+  CHECK(smeagle_last_error(NULL, 0) == 0);
+
+  /* The corpus keeps the library open after its session is closed */
+  smeagle_session_close(session);
+  for (function = smeagle_corpus_next_function(corpus, NULL); function;
+       function = smeagle_corpus_next_function(corpus, function)) {
+    CHECK(smeagle_function_parameter(function, SMEAGLE_RETURN_VALUE, SMEAGLE_PARAMETER_TYPE,
+                                     name, sizeof name)
+          < sizeof name);
+  }
+  smeagle_corpus_free(corpus);
+
+  return failures ? 1 : 0;
+}
@@ -18,11 +18,30 @@ namespace smeagle {
     std::vector<parameter> parameters;
     parameter return_value;
     std::string function_name;
+    std::string member;  // archive member that defines the function, if any
   };
 
   struct abi_variable_description {
     std::string variable_type;
     std::string variable_name;
     int variable_size;
+    std::string member;  // archive member that defines the variable, if any
+  };
+
+  // A symbol of the dynamic symbol table with its version, imported or exported
+  struct abi_dynamic_symbol {
+    std::string name;
+    std::string version;       // empty if the symbol is not versioned
+    std::string version_file;  // imports only: the library the version is required from
+    std::string kind;          // "function", "variable", or empty if the symbol table does not say
+    unsigned size = 0;
+    bool is_weak = false;
+    bool is_default = true;  // exports only: false for a hidden (name@VERSION) version
+  };
+
+  // A symbol that could not be parsed or written, and why
+  struct abi_symbol_error {
+    std::string symbol;
+    std::string reason;
   };
 }  // namespace smeagle
@@ -0,0 +1,108 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "smeagle/corpora.h"
+#include "smeagle/smeagle.h"
+#include "smeagle/stats.h"
+#include "smeagle/type_cache.h"
+
+namespace smeagle {
+
+  namespace ar {
+
+    /**
+     * @brief Does the file start with the magic of an ar archive?
+     */
+    bool has_magic(std::string const &path);
+
+    /**
+     * @brief One member object of an archive, pointing into the archive bytes
+     */
+    struct member {
+      std::string name;
+      char const *data;
+      size_t size;
+    };
+
+    /**
+     * @brief List the members of an archive that is in memory
+     *
+     * Both the GNU (long name table) and BSD (#1/) naming schemes are
+     * understood, and the symbol tables are skipped. Throws
+     * std::runtime_error for thin or malformed archives.
+     */
+    std::vector<member> members(char const *data, size_t size);
+
+  }  // namespace ar
+
+  /**
+   * @brief One corpus for all of the objects in a static archive
+   *
+   * The archive is mapped, and every ELF member is handed to Dyninst from
+   * memory, so nothing is extracted to disk. Members are parsed in
+   * parallel (their interface is their global symbols) and merged into one
+   * corpus, with the member recorded for each function and variable.
+   */
+  class ArchiveCorpus {
+    std::string path;
+    char const *base = nullptr;
+    size_t length = 0;
+    std::vector<ar::member> objects;
+    TypeCache types;
+    std::vector<std::unique_ptr<Smeagle>> opened;
+    std::optional<Corpus> merged;
+    std::map<std::string, std::string> errors;
+
+    CancellationToken const *cancellation = nullptr;
+    LoadProfile profile = LoadProfile::Minimal;
+    std::vector<std::string> debug_dirs;
+
+  public:
+    /**
+     * @brief Map an archive and list its members (throws std::runtime_error)
+     */
+    explicit ArchiveCorpus(std::string path);
+    ~ArchiveCorpus();
+
+    ArchiveCorpus(ArchiveCorpus const &) = delete;
+    ArchiveCorpus &operator=(ArchiveCorpus const &) = delete;
+
+    /**
+     * @brief Parse every member, a member that fails is kept in the errors
+     * @param stats if not null, accumulates the timings of every member
+     */
+    Corpus const &parse(Stats *stats = nullptr);
+
+    /**
+     * @brief Stop parsing the members early, see Smeagle::setCancellation
+     *
+     * Every member is cut short once the token asks to stop, and the merged
+     * corpus is then marked as truncated.
+     */
+    void setCancellation(CancellationToken const *token) { cancellation = token; }
+
+    /**
+     * @brief How much debug information to load for every member, see LoadProfile
+     */
+    void setLoadProfile(LoadProfile _profile) { profile = _profile; }
+
+    /**
+     * @brief Where to look for the debug files of stripped members
+     */
+    void setDebugDirectories(std::vector<std::string> dirs) { debug_dirs = std::move(dirs); }
+
+    std::vector<ar::member> const &getMembers() const { return objects; }
+    std::map<std::string, std::string> const &getErrors() const { return errors; }
+  };
+
+}  // namespace smeagle
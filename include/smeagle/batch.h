@@ -0,0 +1,91 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "smeagle/stats.h"
+
+namespace smeagle {
+
+  /**
+   * @brief One library to parse, and the file its corpus is written to
+   */
+  struct batch_item {
+    std::string library;
+    std::string output;
+  };
+
+  struct batch_outcome {
+    std::string library;
+    std::string output;
+    bool ok = false;
+    bool truncated = false;  // the timeout stopped the parse, the corpus is partial
+    std::string error;
+  };
+
+  struct batch_options {
+    // Parse in this many worker processes, or in this process if 0
+    size_t workers = 0;
+
+    // Replace a worker once its resident set is larger than this (0 for never)
+    std::uint64_t worker_memory_limit = 0;
+
+    // Stop parsing a library after this long and keep a truncated corpus (0 for never)
+    std::chrono::milliseconds timeout{0};
+
+    // Parse one compilation unit at a time under this resident set size (0 for all at once)
+    std::uint64_t memory_budget = 0;
+
+    // Look for the debug files of stripped libraries under these directories
+    std::vector<std::string> debug_dirs;
+
+    // Append every finished library to this journal file (none if empty)
+    std::string journal;
+
+    // Skip the libraries the journal has finished, instead of starting it over
+    bool resume = false;
+  };
+
+  /**
+   * @brief Parse many libraries, writing one corpus json file each
+   *
+   * Libraries are started largest first (by the size of their DWARF and
+   * symbol tables). In this process they are parsed in parallel, and the
+   * threads that run out of libraries help with the symbols of the ones
+   * still going.
+   *
+   * A library that fails does not stop the batch, its error is kept in
+   * its outcome instead. Corpora are written to a temporary file that is
+   * renamed into place, so an output file is never left half written.
+   *
+   * With workers, every library is parsed in one of a set of processes
+   * forked up front, which share the cores and report back over a socket.
+   * A worker that crashes is replaced and its library is recorded as
+   * failed, and a worker that grew past the memory limit is replaced after
+   * its library, since Dyninst does not give memory back. Outcomes are in
+   * item order.
+   *
+   * A timeout stops a parse between symbols. Since Dyninst itself cannot
+   * be interrupted, a worker that is still busy once the timeout has
+   * passed twice over is killed, and its library recorded as failed.
+   *
+   * With a journal, a line is appended and synced for every library as it
+   * finishes, so an interrupted batch can resume: libraries the journal
+   * has as done (with their output still in place) keep their outcome and
+   * are not parsed again, failed ones are retried, and only those that
+   * were in flight are repeated.
+   *
+   * @param stats if not null, accumulates the timings of every library
+   *              (only when parsing in this process)
+   */
+  std::vector<batch_outcome> runBatch(std::vector<batch_item> const &items,
+                                      batch_options const &options = {}, Stats *stats = nullptr);
+
+}  // namespace smeagle
@@ -0,0 +1,78 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "smeagle/corpora.h"
+
+namespace smeagle {
+
+  /**
+   * @brief Where one imported symbol of a library binds to
+   */
+  struct symbol_binding {
+    std::string library;
+    std::string symbol;
+    std::string version;
+
+    // The library that provides the symbol, empty if nothing does
+    std::string provider;
+
+    // What the provider does not agree with (empty if the binding is fine)
+    std::vector<std::string> problems;
+  };
+
+  /**
+   * @brief Bind imported symbols to their providers without running ld.so
+   *
+   * The corpora form the global lookup scope, in the order the dynamic
+   * linker searches it (the breadth first load order, executable first).
+   * Every export is put in one hash index, so a lookup costs the same with
+   * hundreds of dependencies as with one. Symbol versioning is followed:
+   * a versioned reference only binds to that version (hidden ones
+   * included), an unversioned one to the first default definition.
+   *
+   * Dynamic symbol tables only carry the kind and, for data, the size of
+   * a symbol, so those are the caller expectations that are checked.
+   */
+  class SymbolResolver {
+    struct candidate {
+      size_t provider;
+      abi_dynamic_symbol const *symbol;
+    };
+
+    std::vector<Corpus const *> scope;
+    std::unordered_map<std::string, std::vector<candidate>> index;
+
+  public:
+    /**
+     * @param scope the corpora to search, in order (not owned, must outlive the resolver)
+     */
+    explicit SymbolResolver(std::vector<Corpus const *> scope);
+
+    /**
+     * @brief Bind every import of one library
+     */
+    std::vector<symbol_binding> resolve(Corpus const &importer) const;
+
+    /**
+     * @brief Bind the imports of every library in the scope
+     */
+    std::vector<symbol_binding> resolveAll() const;
+
+    /**
+     * @brief Dump bindings to json
+     * @param problems_only leave out the bindings that are fine
+     */
+    static void toJson(std::vector<symbol_binding> const &bindings, std::ostream &out,
+                       bool problems_only = false);
+  };
+
+}  // namespace smeagle
@@ -0,0 +1,119 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "smeagle/corpora.h"
+#include "smeagle/smeagle.h"
+
+namespace smeagle {
+
+  /**
+   * @brief Counters describing how well a CorpusCache is doing
+   */
+  struct cache_stats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t invalidations = 0;
+    size_t entries = 0;
+    size_t capacity = 0;
+  };
+
+  /**
+   * @brief A least recently used cache of open libraries and their corpora
+   *
+   * An entry keeps the Dyninst Symtab of its library open, so repeated
+   * queries skip both the load and the parse. Entries are invalidated when
+   * the file on disk changes (device, inode, size or mtime).
+   *
+   * Dyninst hands out the Symtab it already has for a path, so while a
+   * request still holds an entry that was dropped, a new entry for the same
+   * path opens a copy of the file instead, which gets a Symtab of its own.
+   */
+  class CorpusCache {
+  public:
+    /**
+     * @brief One library, kept warm
+     *
+     * Entries are shared, so one that is evicted while a request is using
+     * it is only closed when that request is done.
+     */
+    class Entry {
+      friend class CorpusCache;
+
+      std::mutex lock;
+      std::vector<char> bytes;  // a copy of the library, if it is not opened by path
+      Smeagle smeagle;
+      std::optional<Corpus> parsed;
+      std::optional<bool> exceptions;
+
+      // Identity of the file when it was opened
+      std::uint64_t device = 0, inode = 0, size = 0;
+      std::int64_t mtime_ns = 0;
+
+    public:
+      explicit Entry(std::string library) : smeagle(std::move(library)) {}
+
+      /**
+       * @brief Open a copy of the library, which Dyninst does not share by path
+       */
+      Entry(std::string library, std::vector<char> _bytes)
+          : bytes(std::move(_bytes)), smeagle(std::move(library), bytes.data(), bytes.size()) {}
+      ~Entry() { smeagle.close(); }
+
+      Entry(Entry const &) = delete;
+      Entry &operator=(Entry const &) = delete;
+
+      /**
+       * @brief The corpus of the library (parsed on first use)
+       */
+      Corpus const &corpus();
+
+      /**
+       * @brief Does the library have exceptions (checked on first use)
+       */
+      bool hasExceptions();
+    };
+
+    explicit CorpusCache(size_t capacity);
+
+    /**
+     * @brief Get the entry for a library, opening it on a miss
+     * @param path the library (resolved to a canonical path)
+     */
+    std::shared_ptr<Entry> get(std::string const &path);
+
+    cache_stats stats() const;
+
+    /**
+     * @brief Dump the cache statistics to json
+     */
+    void toJson(std::ostream &out) const;
+
+  private:
+    using lru_list = std::list<std::pair<std::string, std::shared_ptr<Entry>>>;
+
+    mutable std::mutex lock;
+    size_t capacity;
+    lru_list lru;
+    std::unordered_map<std::string, lru_list::iterator> index;
+    cache_stats counters;
+
+    // Entries that were dropped, which may still be in use (and keep their Symtab open)
+    std::unordered_multimap<std::string, std::weak_ptr<Entry>> released;
+  };
+
+}  // namespace smeagle
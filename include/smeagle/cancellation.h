@@ -0,0 +1,67 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace smeagle {
+
+  /**
+   * @brief Ask a parse to stop early, now or once a deadline has passed
+   *
+   * Stopping is cooperative: the symbol loop of a parse and the writing of
+   * a corpus check the token between symbols, and what was done so far is
+   * kept and marked as truncated. Work inside Dyninst (opening a library,
+   * reading its symbols or its DWARF types) cannot be interrupted.
+   *
+   * A token can be cancelled from any thread, or from a signal handler.
+   */
+  class CancellationToken {
+    using clock = std::chrono::steady_clock;
+
+    mutable std::atomic<bool> cancelled{false};
+    std::atomic<std::int64_t> deadline{0};
+    mutable std::atomic<std::int64_t> checks_left{-1};
+
+  public:
+    void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+
+    /**
+     * @brief Stop once this much time has passed from now
+     */
+    void setTimeout(clock::duration timeout) {
+      deadline.store((clock::now() + timeout).time_since_epoch().count(),
+                     std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Stop once the token has been checked this many times
+     *
+     * A deadline counted in symbols instead of time, so that where a parse
+     * stops does not depend on how fast the machine is.
+     */
+    void setCheckLimit(std::int64_t checks) {
+      checks_left.store(checks, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Has the token been cancelled, or has its deadline passed?
+     */
+    bool stopRequested() const {
+      if (cancelled.load(std::memory_order_relaxed)) return true;
+      if (checks_left.load(std::memory_order_relaxed) >= 0
+          && checks_left.fetch_sub(1, std::memory_order_relaxed) <= 0) {
+        cancelled.store(true, std::memory_order_relaxed);
+        return true;
+      }
+      auto const limit = deadline.load(std::memory_order_relaxed);
+      return limit != 0 && clock::now().time_since_epoch().count() >= limit;
+    }
+  };
+
+}  // namespace smeagle
@@ -0,0 +1,88 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "smeagle/corpora.h"
+#include "smeagle/smeagle.h"
+#include "smeagle/stats.h"
+#include "smeagle/type_cache.h"
+
+namespace smeagle {
+
+  /**
+   * @brief The shared libraries a binary loads, found without running ld.so
+   *
+   * Libraries are searched for like the dynamic loader does: DT_RPATH (when
+   * there is no DT_RUNPATH) of the object and of the root binary,
+   * LD_LIBRARY_PATH, DT_RUNPATH, /etc/ld.so.cache and then the default
+   * directories. $ORIGIN and $LIB are expanded, and candidates for another
+   * ELF class or machine are skipped. All paths are canonical.
+   */
+  struct DependencyGraph {
+    // The binary we started from
+    std::string root;
+
+    // The root and every library it loads, in breadth first order
+    std::vector<std::string> libraries;
+
+    // The resolved DT_NEEDED entries of each library, in order
+    std::map<std::string, std::vector<std::string>> needed;
+
+    // DT_NEEDED entries of each library that could not be found
+    std::map<std::string, std::vector<std::string>> missing;
+  };
+
+  /**
+   * @brief Resolve the DT_NEEDED closure of an ELF binary
+   * @param path an executable or shared library (throws std::runtime_error if not ELF)
+   */
+  DependencyGraph resolveDependencies(std::string const &path);
+
+  /**
+   * @brief The corpora of every library in a dependency graph
+   *
+   * Libraries are parsed in parallel and share one TypeCache. The Dyninst
+   * objects stay open (the corpora refer to their types) until the closure
+   * is destroyed.
+   */
+  class Closure {
+    DependencyGraph graph;
+    TypeCache types;
+    std::vector<std::unique_ptr<Smeagle>> opened;
+    std::map<std::string, Corpus> corpora;
+    std::map<std::string, std::string> errors;
+
+  public:
+    explicit Closure(DependencyGraph graph);
+    ~Closure();
+
+    Closure(Closure const &) = delete;
+    Closure &operator=(Closure const &) = delete;
+
+    /**
+     * @brief Parse every library, a library that fails is kept in the errors
+     * @param stats if not null, accumulates the timings of every library
+     */
+    void parse(Stats *stats = nullptr);
+
+    /**
+     * @brief Dump the graph and the corpora, keyed by library, to json
+     */
+    void toJson(std::ostream &out) const;
+
+    DependencyGraph const &getGraph() const { return graph; }
+    TypeCache const &getTypeCache() const { return types; }
+    std::map<std::string, Corpus> const &getCorpora() const { return corpora; }
+    std::map<std::string, std::string> const &getErrors() const { return errors; }
+  };
+
+}  // namespace smeagle
@@ -5,11 +5,15 @@
 
 #pragma once
 
+#include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "Symtab.h"
+#include "smeagle/cancellation.h"
 #include "smeagle/abi_description.h"
+#include "smeagle/stats.h"
 
 namespace smeagle {
 
@@ -20,6 +24,10 @@ namespace smeagle {
     std::string library;
     std::vector<abi_function_description> functions;
     std::vector<abi_variable_description> variables;
+    std::vector<abi_dynamic_symbol> imports;
+    std::vector<abi_dynamic_symbol> exports;
+    std::vector<abi_symbol_error> errors;
+    bool truncated = false;
 
   public:
     /**
@@ -29,23 +37,157 @@ namespace smeagle {
 
     /**
      * @brief Parse a function symbol into parameters, types, locations
+     *
+     * A symbol that cannot be parsed is recorded in the errors instead.
+     *
      * @param symbol the symbol that is determined to be a function
+     * @param stats optional timings and counters to update
      */
-    void parseFunctionABILocation(Dyninst::SymtabAPI::Symbol*, Dyninst::Architecture);
+    void parseFunctionABILocation(Dyninst::SymtabAPI::Symbol*, Dyninst::Architecture,
+                                  Stats* stats = nullptr);
 
     /**
      * @brief Parse a global variable symbol into parameters, types, locations
      * @param symbol the symbol that is determined to be a global variable
+     * @param stats optional timings and counters to update
      */
-    void parseVariableABILocation(Dyninst::SymtabAPI::Symbol*, Dyninst::Architecture);
+    void parseVariableABILocation(Dyninst::SymtabAPI::Symbol*, Dyninst::Architecture,
+                                  Stats* stats = nullptr);
+
+    /**
+     * @brief Record an undefined symbol of the dynamic symbol table with its version requirement
+     */
+    void parseImport(Dyninst::SymtabAPI::Symbol*);
+
+    /**
+     * @brief Record a defined symbol of the dynamic symbol table with its version
+     */
+    void parseExport(Dyninst::SymtabAPI::Symbol*);
+
+    /**
+     * @brief Move everything from the corpus of one archive member into this one
+     * @param member the name of the member, recorded with its functions and variables
+     *               (or empty to keep theirs, for parts of the same object)
+     */
+    void merge(Corpus&& other, std::string const& member);
 
     /**
      * @brief Dump a corpus to json
+     *
+     * A function that cannot be written is left out of the locations and
+     * listed in the "errors" section, with the errors from parsing.
+     *
+     * @param out the stream to write to
+     * @param stats optional timings and counters to update
+     * @param cancellation optional token, checked between symbols; the json
+     *                     stays valid and is marked as truncated when it stops
      */
-    void toJson();
+    void toJson(std::ostream& out = std::cout, Stats* stats = nullptr,
+                CancellationToken const* cancellation = nullptr) const;
+
+    /**
+     * @brief Read a corpus back from the json that toJson wrote
+     *
+     * The document is read in place, without building a tree of it first.
+     * Parameters keep their json as it was written (with the fields of
+     * aggregates), so the corpus is written out again byte for byte and
+     * compares with diff like the parsed one, without Dyninst or the library.
+     *
+     * @throws std::runtime_error if the json is not a corpus
+     */
+    static Corpus fromJson(std::string_view json);
+
+    /**
+     * @brief Read the corpus json file at path (mapped, not copied)
+     */
+    static Corpus fromJsonFile(std::string const& path);
+
+    /**
+     * @brief Dump a single function or variable to json
+     * @param name the mangled name of the symbol
+     * @return false if the corpus has no symbol with that name
+     */
+    bool symbolToJson(std::string const& name, std::ostream& out) const;
+
+    /**
+     * @brief Dump one entry of the "locations" list (no trailing comma or newline)
+     */
+    static void functionToJson(abi_function_description const& f, std::ostream& out);
+    static void variableToJson(abi_variable_description const& v, std::ostream& out);
+
+    std::string const& getLibrary() const { return library; }
+
+    /**
+     * @brief Approximate number of bytes this corpus keeps alive
+     */
+    size_t retainedSize() const;
 
     std::vector<abi_function_description> const& getFunctions() const { return functions; }
     std::vector<abi_variable_description> const& getVariables() const { return variables; }
+    std::vector<abi_dynamic_symbol> const& getImports() const { return imports; }
+    std::vector<abi_dynamic_symbol> const& getExports() const { return exports; }
+    std::vector<abi_symbol_error> const& getErrors() const { return errors; }
+
+    /**
+     * @brief Did parsing stop before all symbols were seen?
+     */
+    bool isTruncated() const { return truncated; }
+    void setTruncated() { truncated = true; }
+
+    /**
+     * @brief Drop the functions and variables, once they are written
+     */
+    void clearLocations();
+  };
+
+  /**
+   * @brief The locations of a part as written, with the symbols that failed
+   */
+  struct RenderedPart {
+    std::vector<std::string> locations;
+    std::vector<abi_symbol_error> errors;
+  };
+
+  /**
+   * @brief Write the json of a corpus that is produced in parts
+   *
+   * The locations of each part are written as soon as it is added, so the
+   * parts do not have to be kept. Imports, exports and errors come after
+   * the locations, so they are written from one corpus at the end.
+   * Corpus::toJson is a writer with a single part.
+   */
+  class CorpusWriter {
+    std::ostream& out;
+    bool first = true;
+    bool stopped = false;
+    bool truncated = false;
+    std::vector<abi_symbol_error> failed;
+
+  public:
+    CorpusWriter(std::ostream& out, std::string const& library);
+
+    /**
+     * @brief Write the functions and variables of one part
+     * @param rendered if not null, gets the entries and errors of the part as written
+     * @return false once the cancellation token stopped the writing
+     */
+    bool addLocations(Corpus const& part, CancellationToken const* cancellation = nullptr,
+                      RenderedPart* rendered = nullptr);
+
+    /**
+     * @brief Write a part as it was rendered before, errors included
+     */
+    void addRendered(RenderedPart const& part);
+
+    /**
+     * @brief Write the imports, exports and errors of rest, and close the json
+     */
+    void finish(Corpus const& rest);
+
+    /**
+     * @brief How many functions could not be written (and went to the errors)
+     */
+    size_t writeErrors() const { return failed.size(); }
   };
 
 }  // namespace smeagle
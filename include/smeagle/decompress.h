@@ -0,0 +1,45 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <vector>
+
+#include "smeagle/elf.h"
+
+namespace smeagle {
+
+  /**
+   * @brief Buffers for decompressed objects, reused from one library to the next
+   *
+   * An inflated object is as large as its debug information, so a batch
+   * would otherwise allocate (and fault in) that much again per library.
+   */
+  class BufferPool {
+  public:
+    // An empty buffer, which keeps the capacity it had when it was released
+    static std::vector<char> acquire();
+    static void release(std::vector<char> buffer);
+  };
+
+  namespace elf {
+
+    /**
+     * @brief Copy an object with its compressed debug sections decompressed
+     *
+     * Dyninst (through libdw) decompresses SHF_COMPRESSED sections one after
+     * the other while it opens an object. Here the sections are decompressed
+     * in parallel into a copy of the object, placed after its original bytes
+     * with a new section header table, which Dyninst can open from memory.
+     * Only zlib sections are decompressed, others are left for libdw.
+     *
+     * @param file the object to decompress
+     * @param image where to put the copy, reusing its capacity
+     * @return false (leaving image empty) if there was nothing to decompress
+     */
+    bool decompress_debug_sections(File const &file, std::vector<char> &image);
+
+  }  // namespace elf
+}  // namespace smeagle
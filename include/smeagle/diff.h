@@ -0,0 +1,48 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "smeagle/corpora.h"
+
+namespace smeagle {
+
+  /**
+   * @brief A symbol that exists in both corpora but whose ABI description changed
+   */
+  struct symbol_change {
+    std::string name;
+    std::vector<std::string> reasons;
+  };
+
+  /**
+   * @brief The ABI differences between an older and a newer corpus
+   */
+  struct CorpusDiff {
+    std::vector<std::string> added;
+    std::vector<std::string> removed;
+    std::vector<symbol_change> changed;
+
+    bool empty() const { return added.empty() && removed.empty() && changed.empty(); }
+
+    /**
+     * @brief Dump the differences to json
+     */
+    void toJson(std::ostream &out) const;
+  };
+
+  /**
+   * @brief Compare the functions and variables of two corpora by mangled name
+   *
+   * Two symbols are the same when their json descriptions are identical, so a
+   * change to the layout of an aggregate parameter is reported too.
+   */
+  CorpusDiff diff(Corpus const &older, Corpus const &newer);
+
+}  // namespace smeagle
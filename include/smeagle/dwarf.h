@@ -0,0 +1,42 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "smeagle/elf.h"
+
+namespace smeagle::dwarf {
+
+  /**
+   * @brief One compilation unit of .debug_info
+   */
+  struct unit {
+    std::string name;     // DW_AT_name of the unit, which Dyninst names its module after
+    std::uint64_t offset;  // of the unit header in .debug_info
+    std::string hash;     // of the DIEs of the unit, in hex
+  };
+
+  /**
+   * @brief The compilation units of an object, with a hash of what their DIEs say
+   *
+   * The hash walks the DIEs of the unit: their tags and attributes, with
+   * strings by their contents rather than their offsets, and without the
+   * addresses and offsets into other sections (code, line tables, ranges),
+   * which move when a unit or function before them changes. A unit that was
+   * not touched by a rebuild keeps its hash, however the others changed.
+   *
+   * A skeleton unit is followed to its .dwo (under its compilation
+   * directory or next to the object), whose units are hashed with it.
+   *
+   * Objects without (or with compressed) .debug_info have no units here,
+   * and neither do units that cannot be read. Type units are left out.
+   */
+  std::vector<unit> units(elf::File const &file);
+
+}  // namespace smeagle::dwarf
@@ -0,0 +1,175 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace smeagle::elf {
+
+  /**
+   * @brief Does the file start with the ELF magic bytes?
+   */
+  bool has_magic(std::string const &path);
+
+  /**
+   * @brief Do these bytes start with the ELF magic bytes?
+   */
+  bool has_magic(void const *data, size_t size);
+
+  /**
+   * @brief The NUL terminated string at offset in a string table
+   *
+   * The read stays within the table, which comes from an untrusted file: an
+   * offset past its end gives an empty string, and a string that is not
+   * terminated is cut at the end of the table.
+   */
+  inline std::string_view string_at(std::string_view table, std::uint64_t offset) {
+    if (offset >= table.size()) return {};
+    auto const s = table.substr(static_cast<size_t>(offset));
+    return s.substr(0, s.find('\0'));
+  }
+
+  struct section {
+    std::string name;
+    std::uint32_t type;
+    std::uint64_t flags;
+    std::uint64_t addr;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint32_t link;
+    std::uint64_t entsize;
+  };
+
+  /**
+   * @brief A read-only view of an ELF object, without Dyninst
+   *
+   * Files are mapped (not read), so looking at a few headers of a large
+   * library only touches the pages that are needed. Only objects in the
+   * byte order of the host are supported.
+   */
+  class File {
+    std::string path;
+    char const *base = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    bool is64 = false;
+    std::uint16_t elf_type = 0;
+    std::uint16_t elf_machine = 0;
+    std::vector<section> all_sections;
+
+    struct segment {
+      std::uint32_t type;
+      std::uint64_t offset;
+      std::uint64_t vaddr;
+      std::uint64_t filesz;
+    };
+    std::vector<segment> segments;
+
+    void load();
+    std::uint64_t to_offset(std::uint64_t vaddr) const;
+    std::vector<std::string> dynamic(std::int64_t tag) const;
+
+  public:
+    /**
+     * @brief Map a file (throws std::runtime_error if it is not a valid ELF object)
+     */
+    explicit File(std::string path);
+
+    /**
+     * @brief View an object that is already in memory (not owned, must outlive this)
+     */
+    File(void const *data, size_t size, std::string name);
+
+    ~File();
+    File(File const &) = delete;
+    File &operator=(File const &) = delete;
+
+    std::string const &name() const { return path; }
+    char const *data() const { return base; }
+    size_t size() const { return length; }
+
+    std::uint16_t type() const { return elf_type; }
+    std::uint16_t machine() const { return elf_machine; }
+    bool is_64bit() const { return is64; }
+
+    /**
+     * @brief Is this a shared library (and not a position independent executable)?
+     *
+     * Both are ET_DYN, so a library also needs a soname or a ".so" in its name.
+     * Separate debug files (without the code) are not libraries either.
+     */
+    bool is_shared_library() const;
+
+    std::vector<section> const &sections() const { return all_sections; }
+
+    /**
+     * @brief Find a section by name, nullptr if there is none
+     */
+    section const *find_section(std::string_view name) const;
+
+    /**
+     * @brief The raw bytes of a section as stored in the file
+     */
+    std::string_view contents(section const &s) const;
+
+    /**
+     * @brief The GNU build-id in lowercase hex, empty if there is none
+     */
+    std::string build_id() const;
+
+    /**
+     * @brief Does the object carry its own DWARF?
+     *
+     * Stripped objects and the code-only half of a separate debug file have
+     * no .debug_info, or one without contents.
+     */
+    bool has_dwarf() const;
+
+    /**
+     * @brief The file name in .gnu_debuglink, empty if there is none
+     * @param crc if not null, gets the CRC-32 the debug file must have
+     */
+    std::string debuglink(std::uint32_t *crc = nullptr) const;
+
+    /**
+     * @brief A rough estimate of the work to parse this object with Smeagle
+     *
+     * Only meant to order objects against each other: the size of the DWARF
+     * in .debug_info plus a fixed amount per symbol of the symbol table.
+     */
+    std::uint64_t parse_cost() const;
+
+    /**
+     * @brief DT_NEEDED entries of the dynamic section, in order
+     */
+    std::vector<std::string> needed() const;
+
+    std::string soname() const;
+    std::string rpath() const;
+    std::string runpath() const;
+  };
+
+  /**
+   * @brief Find the separate debug file of a stripped object
+   *
+   * The places are the ones GDB looks at: the build-id path
+   * DIR/.build-id/xx/yyyy.debug under each debug directory, then the
+   * .gnu_debuglink name next to the object, in its .debug directory and
+   * under each debug directory followed by the directory of the object.
+   * A debug link is only taken when its build-id matches, and its CRC is
+   * only computed (reading the whole file) when one of them has no build-id.
+   *
+   * @param object the stripped object
+   * @param debug_dirs the debug directories, such as /usr/lib/debug
+   * @return the path of the debug file, empty if the object has its own
+   * DWARF or nothing was found
+   */
+  std::string find_debug_file(File const &object, std::vector<std::string> const &debug_dirs);
+
+}  // namespace smeagle::elf
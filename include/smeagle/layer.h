@@ -0,0 +1,70 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <deque>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "smeagle/corpora.h"
+#include "smeagle/smeagle.h"
+#include "smeagle/stats.h"
+#include "smeagle/type_cache.h"
+
+namespace smeagle {
+
+  /**
+   * @brief The corpora of the shared libraries in a container image layer
+   *
+   * The layer (a tar file, gzip compressed or not, or "-" for stdin) is
+   * read as a stream and never unpacked. Shared libraries are recognized
+   * from their ELF headers, kept in memory, and each one is handed to
+   * Dyninst from memory and parsed in parallel while the rest of the layer
+   * is still being read. Hard links are reported as links to the library
+   * they point to; symlinks and whiteouts are ignored.
+   */
+  class LayerCorpus {
+    struct object {
+      std::string path;
+      std::vector<char> bytes;
+      std::unique_ptr<Smeagle> smeagle;
+      std::optional<Corpus> corpus;
+      std::string error;
+    };
+
+    std::string layer;
+    TypeCache types;
+
+    // A deque, so parses in flight keep their object while more are added
+    std::deque<object> objects;
+    std::map<std::string, std::string> links;
+
+  public:
+    explicit LayerCorpus(std::string layer);
+    ~LayerCorpus();
+
+    LayerCorpus(LayerCorpus const &) = delete;
+    LayerCorpus &operator=(LayerCorpus const &) = delete;
+
+    /**
+     * @brief Read the layer and parse its libraries (throws std::runtime_error if unreadable)
+     * @param stats if not null, accumulates the timings of every library
+     */
+    void parse(Stats *stats = nullptr);
+
+    /**
+     * @brief Dump the corpora, keyed by their path in the layer, to json
+     */
+    void toJson(std::ostream &out) const;
+
+    size_t size() const { return objects.size(); }
+  };
+
+}  // namespace smeagle
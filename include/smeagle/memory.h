@@ -0,0 +1,50 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace smeagle::memory {
+
+  /**
+   * @brief Start counting bytes allocated through operator new
+   *
+   * The library does not replace the global operator new, so programs that
+   * embed it keep their own allocator. Only the Smeagle executable does,
+   * and reports what it allocates with note_allocation. While counting is
+   * disabled (the default) that costs one relaxed atomic load.
+   */
+  void enable();
+  void disable();
+  bool enabled();
+
+  /**
+   * @brief Bytes allocated by the calling thread while counting was enabled
+   *
+   * This only ever grows, so the difference of two calls is what the
+   * thread allocated in between.
+   */
+  std::uint64_t thread_allocated();
+
+  /**
+   * @brief Add an allocation to the bytes of the calling thread (if counting is enabled)
+   *
+   * Called from a replacement of operator new, so it does not allocate.
+   */
+  void note_allocation(std::size_t bytes);
+
+  /**
+   * @brief Peak resident set size of the process in bytes
+   */
+  std::uint64_t peak_rss();
+
+  /**
+   * @brief Current resident set size of the process in bytes
+   */
+  std::uint64_t current_rss();
+
+}  // namespace smeagle::memory
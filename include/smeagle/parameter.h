@@ -30,6 +30,9 @@ namespace smeagle {
     size_t size_in_bytes() const { return self->size_in_bytes(); }
     void toJson(std::ostream &out, int indent) const { self->toJson(out, indent); }
 
+    // Approximate heap footprint of this parameter
+    size_t retained_size() const { return self->retained_size(); }
+
   private:
     struct concept_t {
       virtual ~concept_t() = default;
@@ -40,6 +43,7 @@ namespace smeagle {
       virtual std::string location() const = 0;
       virtual size_t size_in_bytes() const = 0;
       virtual void toJson(std::ostream &, int) const = 0;
+      virtual size_t retained_size() const = 0;
     };
     template <typename T> struct model : concept_t {
       model(T x) : data{std::move(x)} {}
@@ -50,6 +54,10 @@ namespace smeagle {
       std::string location() const override { return data.location(); }
       size_t size_in_bytes() const override { return data.size_in_bytes(); }
       void toJson(std::ostream &out, int indent) const { data.toJson(out, indent); }
+      size_t retained_size() const override {
+        return sizeof(*this) + data.name().size() + data.type_name().size()
+               + data.class_name().size() + data.direction().size() + data.location().size();
+      }
 
       T data;
     };
@@ -0,0 +1,47 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace smeagle::perf {
+
+  /**
+   * @brief The hardware and software events we sample
+   */
+  enum class Event { Cycles, Instructions, CacheMisses, PageFaults, Count };
+
+  constexpr auto num_events = static_cast<size_t>(Event::Count);
+
+  /**
+   * @brief The values of the calling thread's counters at one point in time
+   *
+   * An event that could not be opened (no PMU, perf_event_paranoid, seccomp)
+   * is marked as not valid and its value is zero.
+   */
+  struct Sample {
+    std::array<std::uint64_t, num_events> values{};
+    std::array<bool, num_events> valid{};
+  };
+
+  /**
+   * @brief Open the counters for the calling thread if needed, and read them
+   *
+   * Counters are opened once per thread (with perf_event_open) and closed
+   * when the thread exits. Only user space is counted.
+   */
+  Sample read();
+
+  /**
+   * @brief Can at least one event be counted on the calling thread?
+   */
+  bool supported();
+
+  char const *name(Event event);
+
+}  // namespace smeagle::perf
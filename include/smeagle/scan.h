@@ -0,0 +1,82 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace smeagle {
+
+  /**
+   * @brief The distinct shared libraries found under a directory
+   *
+   * Install trees repeat the same binary many times over (symlinks, hard
+   * links, identical builds under different prefixes). Paths are first
+   * collapsed by inode and then by GNU build-id, and the lexicographically
+   * smallest path of each group is the canonical one that gets parsed.
+   */
+  struct ScanResult {
+    // Canonical paths of the distinct libraries, sorted
+    std::vector<std::string> libraries;
+
+    // Every library path that was found, mapped to its canonical path
+    std::map<std::string, std::string> canonical;
+
+    // Build-id of each canonical library (empty if it has none)
+    std::map<std::string, std::string> build_ids;
+
+    // Size in bytes of each canonical library, used to balance shards
+    std::map<std::string, std::uint64_t> sizes;
+
+    /**
+     * @brief Name of the corpus file for a canonical library
+     *
+     * This is the build-id when there is one, so it is stable across
+     * trees, and a hash of the path otherwise.
+     */
+    std::string corpusName(std::string const &library) const;
+
+    /**
+     * @brief Write the path to canonical mapping as json
+     * @param errors canonical libraries that failed to parse, with the reason
+     */
+    void toJson(std::ostream &out, std::map<std::string, std::string> const &errors = {},
+                bool with_corpora = false) const;
+
+    /**
+     * @brief The part of this result that one of count shards parses
+     *
+     * Libraries are taken largest first (ties broken by corpus name) and
+     * each goes to the shard with the fewest bytes so far, so every node
+     * that scanned the same tree agrees on the assignment without talking
+     * to the others. Paths go with their canonical library.
+     */
+    ScanResult shard(size_t index, size_t count) const;
+
+    /**
+     * @brief Add the libraries and paths of a disjoint result, such as another shard
+     */
+    void merge(ScanResult const &other);
+  };
+
+  /**
+   * @brief Read back an index written by ScanResult::toJson
+   * @param errors if not null, gets the libraries that failed to parse
+   */
+  ScanResult readIndex(std::istream &in, std::map<std::string, std::string> *errors = nullptr);
+
+  /**
+   * @brief Walk a directory tree for ELF shared libraries, without parsing them
+   *
+   * Files are recognized by their ELF magic bytes and type, not by their
+   * extension. Symlinks to files are followed, symlinks to directories are not.
+   */
+  ScanResult scan(std::string const &root);
+
+}  // namespace smeagle
@@ -0,0 +1,74 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+#include "smeagle/cache.h"
+
+namespace smeagle {
+
+  /**
+   * @brief Answer ABI queries over a Unix domain socket, keeping libraries warm
+   *
+   * Clients send one request per line, with arguments separated by spaces:
+   *
+   *   parse <library>
+   *   lookup <library> <mangled symbol name>
+   *   diff <older library> <newer library>
+   *   has-exceptions <library>
+   *   stats
+   *
+   * Every response is a header line "ok <length>" or "error <length>",
+   * followed by exactly <length> bytes of payload (json for "ok").
+   * Each client is served by its own thread, and hung up on if it sends a
+   * line longer than a megabyte.
+   */
+  class Server {
+    std::string socket_path;
+    CorpusCache cache;
+    std::atomic<int> listen_fd{-1};
+    std::atomic<bool> stopping{false};
+
+    std::mutex clients_lock;
+    std::condition_variable clients_done;
+    std::unordered_set<int> client_fds;
+
+    std::atomic<std::uint64_t> requests{0};
+    std::atomic<std::uint64_t> failures{0};
+    std::atomic<std::uint64_t> connections{0};
+
+    void serve(int fd);
+    bool respond(std::string const &request, std::string &payload);
+
+  public:
+    /**
+     * @brief Creates a server (nothing is bound until run)
+     * @param socket_path where to create the socket (a stale one is replaced, a live one is not)
+     * @param cache_capacity how many libraries to keep warm
+     */
+    Server(std::string socket_path, size_t cache_capacity);
+    ~Server();
+
+    /**
+     * @brief Accept and serve clients until stop is called
+     *
+     * Throws std::runtime_error if another server is listening on the socket.
+     */
+    void run();
+
+    /**
+     * @brief Ask run to return (safe to call from a signal handler)
+     */
+    void stop();
+  };
+
+}  // namespace smeagle
@@ -5,21 +5,113 @@
 
 #pragma once
 
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "Symtab.h"
+#include "cancellation.h"
 #include "corpora.h"
+#include "stats.h"
+#include "type_cache.h"
+#include "unit_cache.h"
 
 using namespace Dyninst;
 using namespace SymtabAPI;
 
 namespace smeagle {
 
+  /**
+   * @brief How much of the debug information Dyninst is asked to load
+   *
+   * Minimal only loads the DWARF types, and only if the interface of the
+   * library has a function or variable to describe. Full also loads the
+   * line tables of every module and the local variables of every function,
+   * as a general Dyninst client would, to compare Minimal against (with
+   * --stats and --memory).
+   *
+   * The types cannot be loaded per function: Dyninst parses the DWARF of a
+   * Symtab as a whole, on parseTypesNow or on the first lookup of a type,
+   * parameter or return type, whichever comes first.
+   */
+  enum class LoadProfile {
+    Minimal,  ///< the DWARF types, only when there is something to describe (the default)
+    Full      ///< also the line tables and the local variables of every function
+  };
+
+  /**
+   * @brief A Dyninst Symtab that is closed when its last user lets go of it
+   *
+   * Dyninst opens a file once and hands the same Symtab to everybody who
+   * opens it again, so whoever closed it would pull it out from under the
+   * others. Handles count the users of each Symtab instead.
+   */
+  class SymtabHandle {
+    Symtab* symtab = nullptr;
+
+  public:
+    SymtabHandle() = default;
+
+    /**
+     * @brief Become a user of a Symtab that Symtab::openFile returned
+     */
+    explicit SymtabHandle(Symtab* opened);
+    ~SymtabHandle() { reset(); }
+
+    SymtabHandle(SymtabHandle const&) = delete;
+    SymtabHandle& operator=(SymtabHandle const&) = delete;
+    SymtabHandle(SymtabHandle&& other) noexcept : symtab(other.symtab) { other.symtab = nullptr; }
+    SymtabHandle& operator=(SymtabHandle&& other) noexcept;
+
+    Symtab* get() const { return symtab; }
+    explicit operator bool() const { return symtab != nullptr; }
+
+    /**
+     * @brief Stop using the Symtab, closing it if nobody else does
+     */
+    void reset();
+  };
+
   /**
    * @brief A class for saying hello in multiple languages
    */
   class Smeagle {
     std::string library;
+    void const* image = nullptr;
+    size_t image_size = 0;
+    std::vector<std::string> debug_dirs;
+    std::optional<std::string> debug_file;
+
+    // Copies of the library and its debug file with their debug sections decompressed
+    // (before the Symtabs, which may have been opened from them and go first)
+    std::vector<char> inflated;
+    std::vector<char> debug_inflated;
+
+    SymtabHandle obj;
+    SymtabHandle debug_obj;
+
+    Stats* stats = nullptr;
+    TypeCache* types = nullptr;
+    CancellationToken const* cancellation = nullptr;
+    LoadProfile profile = LoadProfile::Minimal;
+    UnitCache* unit_cache = nullptr;
+
+    // Open an object with Dyninst, from memory if data is not null
+    Symtab* openObject(std::string const& path, void const* data, size_t size,
+                       std::vector<char>& buffer);
+
+    // Open the library with Dyninst (only the first time) and return it
+    Symtab* open();
+
+    // The separate debug file of the library, found once (empty if there is none)
+    std::string const& findDebugFile();
+
+    // Open what has the DWARF of the library: its debug file, or the library itself
+    Symtab* openDebugInfo();
+
+    std::vector<Symbol*> readSymbols(Symtab* symtab);
 
   public:
     /**
@@ -28,15 +120,110 @@ namespace smeagle {
      */
     Smeagle(std::string library);
 
+    /**
+     * @brief Creates a smeagle for an object that is already in memory
+     * @param library the name to report for the object
+     * @param image the bytes of the ELF object (not owned, must outlive this)
+     * @param size the number of bytes
+     */
+    Smeagle(std::string library, void const* image, size_t size);
+
+    /**
+     * @brief Closes the library, see close
+     */
+    ~Smeagle() { close(); }
+
+    Smeagle(Smeagle const&) = delete;
+    Smeagle& operator=(Smeagle const&) = delete;
+    Smeagle(Smeagle&&) noexcept = default;
+    Smeagle& operator=(Smeagle&&) = delete;
+
     /**
      * @brief Parse the library with dyninst
-     * @param fmt the format to print to the screen
-     * @return a string containing the output
+     *
+     * The corpus refers to the Dyninst types of the library, so it must not
+     * be used (written, diffed) after this Smeagle is closed or destroyed.
+     * Keep the Smeagle in a named variable that outlives the corpus, not a
+     * temporary.
+     *
+     * @return the corpus of the library
      */
     smeagle::Corpus parse();
 
+    /**
+     * @brief Parse the library one compilation unit at a time, writing its json as it goes
+     *
+     * The functions and variables of a unit are written and dropped before
+     * the next one, so the corpus is never held whole. Dyninst keeps the
+     * types it loaded until the library is closed, so once the resident set
+     * is over the budget the library is closed and opened again for the
+     * units that are left. That only happens when opening the library (and
+     * the first unit) takes less than the budget, since it could not help
+     * otherwise. The locations are in unit order, not symbol order.
+     *
+     * With a unit cache, units whose DWARF did not change since they were
+     * added to it are written from the cache instead of being described.
+     *
+     * @param out where to write the json of the corpus
+     * @param memory_budget resident set size in bytes to stay under (0 for none)
+     * @return false if the cancellation token stopped it, the json is then truncated
+     */
+    bool stream(std::ostream& out, std::uint64_t memory_budget = 0);
+
     // Determine if the library has exceptions with smeagle
     bool has_exceptions();
+
+    /**
+     * @brief Record phase timings and counters while parsing
+     * @param stats where to record them (not owned, must outlive parse calls)
+     */
+    void setStats(Stats* _stats) { stats = _stats; }
+
+    /**
+     * @brief Share aggregate type classifications with other parses
+     * @param types the cache to use (not owned, must outlive parse calls)
+     */
+    void setTypeCache(TypeCache* _types) { types = _types; }
+
+    /**
+     * @brief Stop parsing early when the token asks for it, keeping a truncated corpus
+     * @param token the token to check between symbols (not owned, must outlive parse calls)
+     */
+    void setCancellation(CancellationToken const* token) { cancellation = token; }
+
+    /**
+     * @brief How much of the debug information parse loads, see LoadProfile
+     *
+     * Both profiles give the same corpus, Full loads what Minimal leaves
+     * out. Streaming leaves the loading to Dyninst's first lookups.
+     */
+    void setLoadProfile(LoadProfile _profile) { profile = _profile; }
+
+    /**
+     * @brief Reuse the locations of unchanged compilation units when streaming
+     * @param cache where to look units up and add them (not owned, must outlive stream calls)
+     */
+    void setUnitCache(UnitCache* cache) { unit_cache = cache; }
+
+    /**
+     * @brief Where to look for the debug file of a stripped library
+     *
+     * A library without DWARF of its own gets its types from the debug file
+     * that elf::find_debug_file finds (next to it or under these directories),
+     * and only its symbol tables are read from the library itself.
+     */
+    void setDebugDirectories(std::vector<std::string> dirs) { debug_dirs = std::move(dirs); }
+
+    /**
+     * @brief Release the Dyninst Symtab of the library (and its debug file), if it was opened
+     *
+     * Corpora parsed from the library refer to the types of its Symtab, so
+     * nothing parsed from it can be used after. Dyninst shares one Symtab per
+     * file, which is only closed once every Smeagle that opened it is closed.
+     */
+    void close();
+
+    std::string const& getLibrary() const { return library; }
   };
 
 }  // namespace smeagle
@@ -0,0 +1,152 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+#include "smeagle/perf_counters.h"
+
+namespace smeagle {
+
+  /**
+   * @brief The phases of a run that we keep timings for
+   *
+   * Params and Allocate happen while a symbol is classified, so their time
+   * is also included in Classify. Decompress happens before Dyninst opens a
+   * library, so it is not included in Open.
+   */
+  enum class Phase {
+    Decompress,
+    Open,
+    Symbols,
+    Types,
+    Classify,
+    Params,
+    Allocate,
+    Serialize,
+    Count
+  };
+
+  /**
+   * @brief The events that we keep counts of
+   */
+  enum class Counter { Symbols, Functions, Variables, Types, Bytes, CorpusBytes, Errors, Count };
+
+  /**
+   * @brief Wall and CPU time per phase, plus counters, for one or more runs
+   *
+   * All updates are atomic, so one Stats can be shared between threads.
+   */
+  class Stats {
+  public:
+    using duration = std::chrono::nanoseconds;
+
+    /**
+     * @brief Add one timed call of a phase
+     * @param phase the phase that was timed
+     * @param wall the elapsed wall clock time
+     * @param cpu the CPU time used by the calling thread
+     */
+    void addTime(Phase phase, duration wall, duration cpu);
+
+    /**
+     * @brief Add the bytes allocated during one timed call of a phase
+     */
+    void addAllocated(Phase phase, std::uint64_t bytes);
+
+    /**
+     * @brief Add the counter deltas of one timed call of a phase
+     */
+    void addPerf(Phase phase, perf::Sample const &start, perf::Sample const &end);
+
+    /**
+     * @brief Also sample perf_event counters around every timed phase
+     * @return false if no counter is available, in which case only timings are kept
+     */
+    bool enablePerfCounters();
+    bool perfEnabled() const { return perf_enabled; }
+
+    /**
+     * @brief Count the bytes allocated in every timed phase, and report peak RSS
+     *
+     * This turns on the (process wide) allocation counting in smeagle::memory,
+     * which only sees allocations in a program that reports them (such as the
+     * Smeagle executable), peak RSS is always reported.
+     */
+    void enableMemory();
+    bool memoryEnabled() const { return memory_enabled; }
+
+    /**
+     * @brief Increment a counter
+     */
+    void add(Counter counter, std::uint64_t n = 1);
+
+    std::uint64_t get(Counter counter) const;
+    std::uint64_t calls(Phase phase) const;
+    duration wallTime(Phase phase) const;
+    duration cpuTime(Phase phase) const;
+    std::uint64_t allocated(Phase phase) const;
+    std::uint64_t perfCount(Phase phase, perf::Event event) const;
+    bool perfValid(perf::Event event) const;
+
+    /**
+     * @brief Write a human readable report (e.g., to std::cerr)
+     */
+    void toText(std::ostream &out) const;
+
+    /**
+     * @brief Write the report as a json object
+     */
+    void toJson(std::ostream &out) const;
+
+    static char const *name(Phase phase);
+    static char const *name(Counter counter);
+
+  private:
+    struct timing {
+      std::atomic<std::uint64_t> wall_ns{0};
+      std::atomic<std::uint64_t> cpu_ns{0};
+      std::atomic<std::uint64_t> calls{0};
+      std::atomic<std::uint64_t> allocated{0};
+    };
+    std::array<timing, static_cast<size_t>(Phase::Count)> phases;
+    std::array<std::atomic<std::uint64_t>, static_cast<size_t>(Counter::Count)> counters{};
+
+    bool memory_enabled = false;
+    bool perf_requested = false;
+    bool perf_enabled = false;
+    std::array<std::atomic<bool>, perf::num_events> perf_valid{};
+    std::array<std::array<std::atomic<std::uint64_t>, perf::num_events>,
+               static_cast<size_t>(Phase::Count)>
+        perf_counts{};
+  };
+
+  /**
+   * @brief Attribute the time spent in the enclosing scope to a phase
+   *
+   * This does nothing (and reads no clocks) when stats is null.
+   */
+  class PhaseTimer {
+    Stats *stats;
+    Phase phase;
+    std::chrono::steady_clock::time_point wall_start;
+    Stats::duration cpu_start;
+    perf::Sample perf_start;
+    std::uint64_t allocated_start = 0;
+
+  public:
+    PhaseTimer(Stats *stats, Phase phase);
+    ~PhaseTimer();
+
+    PhaseTimer(PhaseTimer const &) = delete;
+    PhaseTimer &operator=(PhaseTimer const &) = delete;
+  };
+
+}  // namespace smeagle
@@ -0,0 +1,87 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+
+namespace smeagle::trace {
+
+  /**
+   * @brief True if the SMEAGLE_TRACE_SPAN instrumentation was compiled in
+   */
+#ifdef SMEAGLE_ENABLE_TRACING
+  constexpr bool available = true;
+#else
+  constexpr bool available = false;
+#endif
+
+  /**
+   * @brief Start recording spans on every thread
+   */
+  void start();
+
+  /**
+   * @brief Stop recording spans (already recorded spans are kept)
+   */
+  void stop();
+
+  /**
+   * @brief Are we currently recording?
+   */
+  bool enabled();
+
+  /**
+   * @brief Drop all recorded spans
+   */
+  void clear();
+
+  /**
+   * @brief Write the recorded spans as Chrome trace-event json
+   *
+   * The output can be loaded in chrome://tracing or https://ui.perfetto.dev
+   */
+  void write(std::ostream &out);
+
+  /**
+   * @brief A complete event ("ph":"X") covering the lifetime of this object
+   *
+   * Prefer the SMEAGLE_TRACE_SPAN macro, which compiles to nothing unless
+   * SMEAGLE_ENABLE_TRACING is defined.
+   */
+  class Span {
+    char const *category;
+    std::string name;
+    std::string detail;
+    std::chrono::steady_clock::time_point start;
+    bool active;
+
+  public:
+    // An inactive span that records nothing
+    Span();
+    Span(char const *category, std::string name, std::string detail = {});
+    ~Span();
+
+    Span(Span const &) = delete;
+    Span &operator=(Span const &) = delete;
+  };
+
+}  // namespace smeagle::trace
+
+#define SMEAGLE_TRACE_CONCAT_(a, b) a##b
+#define SMEAGLE_TRACE_CONCAT(a, b) SMEAGLE_TRACE_CONCAT_(a, b)
+
+// SMEAGLE_TRACE_SPAN(category, name[, detail])
+// The name and detail are only evaluated while a trace is being recorded.
+#ifdef SMEAGLE_ENABLE_TRACING
+#  define SMEAGLE_TRACE_SPAN(category, ...)                                          \
+    ::smeagle::trace::Span SMEAGLE_TRACE_CONCAT(smeagle_trace_span_, __LINE__)       \
+        = ::smeagle::trace::enabled() ? ::smeagle::trace::Span(category, __VA_ARGS__) \
+                                      : ::smeagle::trace::Span()
+#else
+#  define SMEAGLE_TRACE_SPAN(category, ...) static_cast<void>(0)
+#endif
@@ -0,0 +1,109 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace smeagle {
+
+  /**
+   * @brief Register classes of aggregate types, shared between libraries
+   *
+   * The same types (from common headers) show up in every library of a
+   * program, each with its own Dyninst objects. The classification only
+   * depends on the layout, so it is keyed by a
+   * fingerprint of it: the kinds, sizes and offsets of the fields, down to
+   * the scalars. Names are not part of it, since libraries (or compilation
+   * units) can each have a struct of the same name and size with other
+   * fields.
+   *
+   * The parsers look the cache up through a Scope, which is set per thread,
+   * so one cache can be shared by parallel parses. Each thread also
+   * remembers the classification of every Dyninst type it has seen in a
+   * session (the parse of one Symtab), so a type is only fingerprinted (and
+   * the shared cache only locked) the first time.
+   */
+  class TypeCache {
+  public:
+    // The low and high register classes of the architecture, as integers
+    struct entry {
+      int lo, hi;
+    };
+
+    std::optional<entry> find(std::string const &key) const;
+    void insert(std::string const &key, entry value);
+
+    size_t size() const;
+    std::uint64_t hits() const { return hit_count; }
+    std::uint64_t misses() const { return miss_count; }
+
+    /**
+     * @brief The cache used by parses on this thread, or nullptr
+     */
+    static TypeCache *active();
+
+    /**
+     * @brief A new session, for the scopes of the parse of one Symtab
+     */
+    static std::uint64_t newSession();
+
+    /**
+     * @brief Make a cache active on this thread for as long as the scope lives
+     *
+     * Types are remembered by address, so a session must not outlive the
+     * Symtab whose types are classified in it.
+     */
+    class Scope {
+      TypeCache *cache;
+      Scope *previous;
+      std::uint64_t session;
+      int depth = 0;
+
+    public:
+      /**
+       * @param cache the cache to share classifications through (or nullptr)
+       * @param session scopes of the same session share the types they have
+       *                seen on a thread (0 for a session of its own)
+       */
+      explicit Scope(TypeCache *cache, std::uint64_t session = 0);
+      ~Scope();
+      Scope(Scope const &) = delete;
+      Scope &operator=(Scope const &) = delete;
+
+      /**
+       * @brief The innermost scope of this thread, or nullptr
+       */
+      static Scope *current();
+
+      TypeCache *getCache() const { return cache; }
+
+      /**
+       * @brief The classification of a type this thread has seen in the session
+       */
+      std::optional<entry> recall(void const *type) const;
+      void remember(void const *type, entry value);
+
+      /**
+       * @brief Is an aggregate being classified? (its members are not looked up on their own)
+       */
+      bool nested() const { return depth > 0; }
+      void enter() { depth++; }
+      void leave() { depth--; }
+    };
+
+  private:
+    mutable std::shared_mutex lock;
+    std::unordered_map<std::string, entry> classes;
+    mutable std::atomic<std::uint64_t> hit_count{0};
+    mutable std::atomic<std::uint64_t> miss_count{0};
+  };
+
+}  // namespace smeagle
@@ -0,0 +1,53 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+
+#include "smeagle/corpora.h"
+
+namespace smeagle {
+
+  /**
+   * @brief The written locations of compilation units, by the hash of their DWARF
+   *
+   * A rebuild after a small change leaves the DIEs of most compilation units
+   * the same (see dwarf::units), and the locations of their functions and
+   * variables only depend on those and on which of their symbols are in the
+   * interface. Smeagle::stream looks every unit up here by both before
+   * describing it, and only the units that changed are parsed again.
+   *
+   * The cache is a json file next to the corpora. Saving it only keeps the
+   * units that were looked up or added since it was loaded, so it tracks
+   * the latest version of the library instead of growing with every build.
+   */
+  class UnitCache {
+    std::map<std::string, RenderedPart> units;
+    std::set<std::string> used;
+    std::uint64_t hit_count = 0;
+    std::uint64_t miss_count = 0;
+
+  public:
+    std::optional<RenderedPart> find(std::string const &hash);
+    void insert(std::string const &hash, RenderedPart part);
+
+    /**
+     * @brief Add the units of a saved cache (throws std::runtime_error if it is not one)
+     */
+    void load(std::istream &in);
+    void save(std::ostream &out) const;
+
+    size_t size() const { return units.size(); }
+    std::uint64_t hits() const { return hit_count; }
+    std::uint64_t misses() const { return miss_count; }
+  };
+
+}  // namespace smeagle
@@ -0,0 +1,94 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "smeagle/diff.h"
+
+namespace smeagle {
+
+  /**
+   * @brief What happened to one library of a watched tree
+   */
+  struct watch_event {
+    enum class kind { added, changed, removed, failed };
+
+    std::string library;
+    kind what;
+    CorpusDiff diff;    // changed: against the last version that was parsed
+    std::string error;  // failed: why the new version could not be parsed
+  };
+
+  /**
+   * @brief Follow a build tree, describing how each relinked library changed
+   *
+   * Every shared library under the root is parsed once up front. Directories
+   * are watched with inotify, and a library is parsed again once nothing has
+   * written to it for the debounce interval, since linkers write their output
+   * in many steps (or under another name, then rename it). The new corpus is
+   * compared with the last one, and the libraries that did not change are
+   * never parsed again.
+   *
+   * The last version of each library is kept as a copy of its bytes, open
+   * with Dyninst from memory, since its corpus refers to Dyninst types and
+   * the file on disk is gone (or rewritten) by the time it is compared.
+   */
+  class Watcher {
+    struct version;
+
+    std::string root;
+    std::chrono::milliseconds debounce;
+    int inotify_fd = -1;
+    int wake_fds[2] = {-1, -1};
+    std::map<int, std::string> directories;  // by watch descriptor
+    std::map<std::string, std::unique_ptr<version>> versions;
+
+    // Paths written to, and when they were last written
+    std::map<std::string, std::chrono::steady_clock::time_point> pending;
+
+    std::vector<watch_event> initial;
+
+    void watchTree(std::string const &directory, std::vector<std::string> &libraries);
+    void readEvents();
+    std::optional<watch_event> analyze(std::string const &path);
+
+  public:
+    /**
+     * @brief Watch a tree and parse the libraries it has now
+     * @param root the directory to watch (recursively)
+     * @param debounce how long a library must be left alone before it is parsed again
+     */
+    Watcher(std::string root, std::chrono::milliseconds debounce);
+    ~Watcher();
+
+    Watcher(Watcher const &) = delete;
+    Watcher &operator=(Watcher const &) = delete;
+
+    /**
+     * @brief The libraries that are parsed, with the ones that failed
+     */
+    std::vector<watch_event> const &baseline() const { return initial; }
+
+    /**
+     * @brief Wait for libraries to change, and describe how they did
+     * @param timeout how long to wait for a library to be written (negative for ever)
+     * @return the events, empty if the timeout passed or stop was called
+     */
+    std::vector<watch_event> wait(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief Make wait return (async-signal-safe)
+     */
+    void stop();
+  };
+
+}  // namespace smeagle
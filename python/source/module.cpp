@@ -0,0 +1,152 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <smeagle/diff.h>
+#include <smeagle/smeagle.h>
+#include <smeagle/version.h>
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+namespace py = pybind11;
+using namespace smeagle;
+
+namespace {
+  // Python decides when a library is done with, so closing it is left to the collector
+  struct closing_delete {
+    void operator()(Smeagle *smeagle) const {
+      smeagle->close();
+      delete smeagle;
+    }
+  };
+}  // namespace
+
+// Corpora are read where they are, nothing goes through json. Functions and
+// variables are iterated over the vectors of the corpus, and every object
+// handed out keeps its corpus alive, as the corpus keeps its Smeagle (whose
+// Dyninst types it refers to). Strings are converted when they are read.
+PYBIND11_MODULE(smeagle, m) {
+  m.doc() = "Extract library metadata, the precious.";
+  m.attr("__version__") = SMEAGLE_VERSION;
+
+  py::class_<parameter>(m, "Parameter")
+      .def_property_readonly("name", &parameter::name)
+      .def_property_readonly("type_name", &parameter::type_name)
+      .def_property_readonly("class_name", &parameter::class_name)
+      .def_property_readonly("direction", &parameter::direction)
+      .def_property_readonly("location", &parameter::location)
+      .def_property_readonly("size", &parameter::size_in_bytes)
+      .def("to_json", [](parameter const &p) {
+        std::ostringstream out;
+        p.toJson(out, 0);
+        return out.str();
+      });
+
+  py::class_<abi_function_description>(m, "Function")
+      .def_readonly("name", &abi_function_description::function_name)
+      .def_readonly("member", &abi_function_description::member)
+      .def_readonly("parameters", &abi_function_description::parameters)
+      .def_readonly("return_value", &abi_function_description::return_value)
+      .def("to_json", [](abi_function_description const &f) {
+        std::ostringstream out;
+        Corpus::functionToJson(f, out);
+        return out.str();
+      });
+
+  py::class_<abi_variable_description>(m, "Variable")
+      .def_readonly("name", &abi_variable_description::variable_name)
+      .def_readonly("type_name", &abi_variable_description::variable_type)
+      .def_readonly("size", &abi_variable_description::variable_size)
+      .def_readonly("member", &abi_variable_description::member);
+
+  py::class_<abi_dynamic_symbol>(m, "DynamicSymbol")
+      .def_readonly("name", &abi_dynamic_symbol::name)
+      .def_readonly("version", &abi_dynamic_symbol::version)
+      .def_readonly("version_file", &abi_dynamic_symbol::version_file)
+      .def_readonly("kind", &abi_dynamic_symbol::kind)
+      .def_readonly("size", &abi_dynamic_symbol::size)
+      .def_readonly("is_weak", &abi_dynamic_symbol::is_weak)
+      .def_readonly("is_default", &abi_dynamic_symbol::is_default);
+
+  py::class_<abi_symbol_error>(m, "SymbolError")
+      .def_readonly("symbol", &abi_symbol_error::symbol)
+      .def_readonly("reason", &abi_symbol_error::reason);
+
+  py::class_<Corpus>(m, "Corpus")
+      .def_property_readonly("library", &Corpus::getLibrary)
+      .def_property_readonly("truncated", &Corpus::isTruncated)
+      .def(
+          "functions",
+          [](Corpus const &c) {
+            return py::make_iterator(c.getFunctions().begin(), c.getFunctions().end());
+          },
+          py::keep_alive<0, 1>(), "Iterate over the functions, without copying them")
+      .def(
+          "variables",
+          [](Corpus const &c) {
+            return py::make_iterator(c.getVariables().begin(), c.getVariables().end());
+          },
+          py::keep_alive<0, 1>(), "Iterate over the global variables, without copying them")
+      .def(
+          "function",
+          [](Corpus const &c, std::string const &name) -> abi_function_description const * {
+            for (auto const &f : c.getFunctions()) {
+              if (f.function_name == name) return &f;
+            }
+            return nullptr;
+          },
+          py::return_value_policy::reference_internal,
+          "The function with this mangled name, or None")
+      .def_property_readonly("function_count",
+                             [](Corpus const &c) { return c.getFunctions().size(); })
+      .def_property_readonly("variable_count",
+                             [](Corpus const &c) { return c.getVariables().size(); })
+      .def_property_readonly("imports", &Corpus::getImports,
+                             py::return_value_policy::reference_internal)
+      .def_property_readonly("exports", &Corpus::getExports,
+                             py::return_value_policy::reference_internal)
+      .def_property_readonly("errors", &Corpus::getErrors,
+                             py::return_value_policy::reference_internal)
+      .def("to_json", [](Corpus const &c) {
+        std::ostringstream out;
+        c.toJson(out);
+        return out.str();
+      });
+
+  py::class_<symbol_change>(m, "SymbolChange")
+      .def_readonly("name", &symbol_change::name)
+      .def_readonly("reasons", &symbol_change::reasons);
+
+  py::class_<CorpusDiff>(m, "CorpusDiff")
+      .def_readonly("added", &CorpusDiff::added)
+      .def_readonly("removed", &CorpusDiff::removed)
+      .def_readonly("changed", &CorpusDiff::changed)
+      .def("empty", &CorpusDiff::empty)
+      .def("to_json", [](CorpusDiff const &d) {
+        std::ostringstream out;
+        d.toJson(out);
+        return out.str();
+      });
+
+  m.def("diff", &diff, py::arg("older"), py::arg("newer"),
+        "Compare the functions and variables of two corpora by mangled name");
+
+  py::enum_<LoadProfile>(m, "LoadProfile")
+      .value("Minimal", LoadProfile::Minimal)
+      .value("Full", LoadProfile::Full);
+
+  // Parsing releases the GIL, so Python threads can parse libraries in parallel
+  py::class_<Smeagle, std::unique_ptr<Smeagle, closing_delete>>(m, "Smeagle")
+      .def(py::init<std::string>(), py::arg("library"))
+      .def_property_readonly("library", &Smeagle::getLibrary)
+      .def("parse", &Smeagle::parse, py::call_guard<py::gil_scoped_release>(),
+           py::keep_alive<0, 1>(), "Parse the library, the corpus keeps it open")
+      .def("has_exceptions", &Smeagle::has_exceptions, py::call_guard<py::gil_scoped_release>())
+      .def("set_load_profile", &Smeagle::setLoadProfile, py::arg("profile"))
+      .def("set_debug_directories", &Smeagle::setDebugDirectories, py::arg("directories"));
+}
@@ -0,0 +1,49 @@
+# Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+# Spack Project Developers. See the top-level COPYRIGHT file for details.
+#
+# SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+# Run with the built module on the path:
+#   PYTHONPATH=build/python python3 -m pytest python/test
+
+import shutil
+import threading
+
+import smeagle
+
+# The module is a shared library too, with PyInit_smeagle as its interface
+library = smeagle.__file__
+
+
+def test_parse():
+    corpus = smeagle.Smeagle(library).parse()
+    assert corpus.library == library
+    assert not corpus.truncated
+    assert "PyInit_smeagle" in [symbol.name for symbol in corpus.exports]
+    assert sum(1 for _ in corpus.functions()) == corpus.function_count
+    assert corpus.to_json().startswith("{")
+
+
+def test_corpus_outlives_its_smeagle():
+    corpus = smeagle.Smeagle(library).parse()
+    functions = list(corpus.functions())
+    del corpus
+    for function in functions:
+        for parameter in function.parameters:
+            assert parameter.location is not None
+
+
+def test_parse_in_threads(tmp_path):
+    # Dyninst shares one Symtab per file, so each thread gets a copy of its own
+    copies = [shutil.copy(library, tmp_path / ("copy%d.so" % i)) for i in range(4)]
+    corpora = [None] * len(copies)
+
+    def parse(i):
+        corpora[i] = smeagle.Smeagle(str(copies[i])).parse()
+
+    threads = [threading.Thread(target=parse, args=(i,)) for i in range(len(corpora))]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert smeagle.diff(corpora[0], corpora[-1]).empty()
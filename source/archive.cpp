@@ -0,0 +1,182 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/archive.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "largest_first.hpp"
+#include "mapped_file.hpp"
+#include "smeagle/elf.h"
+#include "smeagle/trace.h"
+
+using namespace smeagle;
+
+namespace {
+  constexpr char magic[] = "!<arch>\n";
+  constexpr char thin_magic[] = "!<thin>\n";
+  constexpr size_t magic_size = sizeof magic - 1;
+  constexpr size_t header_size = 60;
+
+  // Header fields are space padded ASCII
+  std::string field(char const *header, size_t offset, size_t width) {
+    std::string value(header + offset, width);
+    value.erase(value.find_last_not_of(' ') + 1);
+    return value;
+  }
+}  // namespace
+
+bool ar::has_magic(std::string const &path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  char buffer[magic_size];
+  auto const n = read(fd, buffer, sizeof buffer);
+  close(fd);
+  return n == static_cast<ssize_t>(magic_size)
+         && (std::memcmp(buffer, magic, magic_size) == 0
+             || std::memcmp(buffer, thin_magic, magic_size) == 0);
+}
+
+std::vector<ar::member> ar::members(char const *data, size_t size) {
+  if (size >= magic_size && std::memcmp(data, thin_magic, magic_size) == 0) {
+    throw std::runtime_error{"Thin archives are not supported, their members are separate files"};
+  }
+  if (size < magic_size || std::memcmp(data, magic, magic_size) != 0) {
+    throw std::runtime_error{"Not an ar archive"};
+  }
+
+  std::vector<member> found;
+  std::string_view long_names;
+  size_t pos = magic_size;
+  while (size - pos >= header_size) {
+    char const *header = data + pos;
+    if (header[58] != '`' || header[59] != '\n') {
+      throw std::runtime_error{"Malformed ar member header"};
+    }
+    auto name = field(header, 0, 16);
+    auto const member_size = std::strtoull(field(header, 48, 10).c_str(), nullptr, 10);
+    pos += header_size;
+    if (member_size > size - pos) {
+      throw std::runtime_error{"Truncated ar member '" + name + "'"};
+    }
+    char const *contents = data + pos;
+    size_t contents_size = member_size;
+
+    // Members are aligned to two bytes
+    pos += member_size + (member_size & 1);
+
+    if (name == "/" || name == "/SYM64/" || name == "__.SYMDEF" || name == "__.SYMDEF SORTED") {
+      continue;
+    }
+    if (name == "//") {
+      long_names = std::string_view(contents, contents_size);
+      continue;
+    }
+
+    if (name.size() > 1 && name[0] == '/') {
+      // GNU: an offset into the long name table, where names end with "/\n"
+      auto const offset = std::strtoull(name.c_str() + 1, nullptr, 10);
+      if (offset >= long_names.size()) {
+        throw std::runtime_error{"Bad long name in ar archive"};
+      }
+      auto const rest = long_names.substr(offset);
+      name = std::string(rest.substr(0, rest.find('\n')));
+    } else if (name.compare(0, 3, "#1/") == 0) {
+      // BSD: the name is stored before the contents
+      auto const name_size = std::strtoull(name.c_str() + 3, nullptr, 10);
+      if (name_size > contents_size) {
+        throw std::runtime_error{"Bad long name in ar archive"};
+      }
+      name = std::string(contents, name_size);
+      name.erase(name.find_last_not_of('\0') + 1);
+      contents += name_size;
+      contents_size -= name_size;
+    }
+    if (!name.empty() && name.back() == '/') {
+      name.pop_back();
+    }
+    found.push_back({std::move(name), contents, contents_size});
+  }
+  return found;
+}
+
+ArchiveCorpus::ArchiveCorpus(std::string _path) : path(std::move(_path)) {
+  std::tie(base, length) = map_file(path);
+  try {
+    objects = ar::members(base, length);
+  } catch (std::runtime_error const &e) {
+    unmap_file(base, length);
+    throw std::runtime_error{"'" + path + "': " + e.what()};
+  }
+}
+
+ArchiveCorpus::~ArchiveCorpus() {
+  // The corpus refers to types of the open objects, which refer to the mapping
+  merged.reset();
+  for (auto &smeagle : opened) {
+    smeagle->close();
+  }
+  unmap_file(base, length);
+}
+
+Corpus const &ArchiveCorpus::parse(Stats *stats) {
+  SMEAGLE_TRACE_SPAN("archive", "parse", path);
+  merged.reset();
+  opened.clear();
+  errors.clear();
+
+  // Archives can also hold other things (e.g. LLVM bitcode), which are skipped
+  std::vector<ar::member const *> elves;
+  for (auto const &m : objects) {
+    if (elf::has_magic(m.data, m.size)) {
+      elves.push_back(&m);
+      opened.push_back(std::make_unique<Smeagle>(path + "(" + m.name + ")", m.data, m.size));
+      opened.back()->setStats(stats);
+      opened.back()->setTypeCache(&types);
+      opened.back()->setCancellation(cancellation);
+      opened.back()->setLoadProfile(profile);
+      opened.back()->setDebugDirectories(debug_dirs);
+    }
+  }
+
+  // Every task only touches its own slot
+  std::vector<std::optional<Corpus>> parsed(elves.size());
+  std::vector<std::string> failures(elves.size());
+  std::vector<std::uint64_t> costs;
+  for (auto const *m : elves) {
+    try {
+      costs.push_back(elf::File(m->data, m->size, m->name).parse_cost());
+    } catch (std::runtime_error const &) {
+      costs.push_back(0);
+    }
+  }
+  largest_first(costs, [&](size_t i) {
+    SMEAGLE_TRACE_SPAN("archive", "member", elves[i]->name);
+    try {
+      parsed[i].emplace(opened[i]->parse());
+    } catch (std::exception const &e) {
+      failures[i] = e.what();
+    }
+  });
+
+  // Merge in archive order, so the result does not depend on scheduling
+  merged.emplace(path);
+  for (size_t i = 0; i < elves.size(); i++) {
+    if (parsed[i]) {
+      merged->merge(std::move(*parsed[i]), elves[i]->name);
+    } else {
+      errors.emplace(elves[i]->name, failures[i]);
+    }
+  }
+  return *merged;
+}
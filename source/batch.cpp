@@ -0,0 +1,505 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/batch.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <smeagle/corpora.h>
+#include <smeagle/elf.h>
+#include <smeagle/memory.h>
+#include <smeagle/smeagle.h>
+#include <smeagle/trace.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <tbb/global_control.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include "largest_first.hpp"
+
+using namespace smeagle;
+
+namespace {
+  using clock = std::chrono::steady_clock;
+
+  // How much work a library is, to start the biggest ones first
+  std::uint64_t parse_cost(std::string const &library) {
+    try {
+      return elf::File(library).parse_cost();
+    } catch (std::runtime_error const &) {
+      return 0;
+    }
+  }
+
+  // Parse one library and write its corpus, throwing on any failure
+  // Returns whether the timeout cut the corpus short
+  bool parse_one(batch_item const &item, batch_options const &options, Stats *stats) {
+    SMEAGLE_TRACE_SPAN("batch", "library", item.library);
+    CancellationToken token;
+    if (options.timeout.count() > 0) {
+      token.setTimeout(options.timeout);
+    }
+    Smeagle smeagle(item.library);
+    smeagle.setStats(stats);
+    smeagle.setCancellation(&token);
+    smeagle.setDebugDirectories(options.debug_dirs);
+
+    auto const partial = item.output + ".partial";
+    bool truncated = false;
+    try {
+      std::ofstream out(partial);
+      if (options.memory_budget > 0) {
+        truncated = !smeagle.stream(out, options.memory_budget);
+      } else {
+        Corpus corpus = smeagle.parse();
+        corpus.toJson(out, stats);
+        truncated = corpus.isTruncated();
+      }
+      out.close();
+      if (!out) {
+        throw std::runtime_error{"Cannot write '" + partial + "'"};
+      }
+      if (std::rename(partial.c_str(), item.output.c_str()) != 0) {
+        throw std::runtime_error{"Cannot rename '" + partial + "' to '" + item.output + "'"};
+      }
+    } catch (...) {
+      std::remove(partial.c_str());
+      smeagle.close();
+      throw;
+    }
+    smeagle.close();
+    return truncated;
+  }
+
+  // Parse one library, keeping any error in the outcome
+  batch_outcome run_one(batch_item const &item, batch_options const &options, Stats *stats) {
+    batch_outcome outcome{item.library, item.output, false, false, {}};
+    try {
+      outcome.truncated = parse_one(item, options, stats);
+      outcome.ok = true;
+    } catch (std::exception const &e) {
+      outcome.error = e.what();
+    } catch (...) {
+      outcome.error = "Unknown exception";
+    }
+    return outcome;
+  }
+
+  // Journal fields are tab separated, so tabs, newlines and backslashes are escaped
+  std::string escape(std::string const &field) {
+    std::string escaped;
+    for (char c : field) {
+      switch (c) {
+        case '\\':
+          escaped += "\\\\";
+          break;
+        case '\t':
+          escaped += "\\t";
+          break;
+        case '\n':
+          escaped += "\\n";
+          break;
+        default:
+          escaped += c;
+      }
+    }
+    return escaped;
+  }
+
+  std::vector<std::string> split_fields(std::string const &line) {
+    std::vector<std::string> fields(1);
+    for (size_t i = 0; i < line.size(); i++) {
+      if (line[i] == '\t') {
+        fields.emplace_back();
+      } else if (line[i] == '\\' && i + 1 < line.size()) {
+        auto const c = line[++i];
+        fields.back() += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+      } else {
+        fields.back() += line[i];
+      }
+    }
+    return fields;
+  }
+
+  // An append-only record of finished libraries, one line each:
+  // <ok|truncated|failed> <library> <output> <error>
+  class Journal {
+    int fd = -1;
+
+  public:
+    Journal(std::string const &path, bool append) {
+      auto const flags = O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC | (append ? 0 : O_TRUNC);
+      fd = open(path.c_str(), flags, 0644);
+      if (fd < 0) {
+        throw std::runtime_error{"Cannot open the journal '" + path + "'"};
+      }
+      if (append && !drop_torn_line()) {
+        close(fd);
+        throw std::runtime_error{"Cannot repair the journal '" + path + "'"};
+      }
+    }
+
+    ~Journal() { close(fd); }
+
+    Journal(Journal const &) = delete;
+    Journal &operator=(Journal const &) = delete;
+
+    // Cut a last line without its newline (we died writing it), so the next
+    // record is not glued onto it
+    bool drop_torn_line() {
+      struct stat st {};
+      if (fstat(fd, &st) != 0) return false;
+      auto end = static_cast<off_t>(st.st_size);
+      char buffer[4096];
+      while (end > 0) {
+        auto const size = std::min<off_t>(end, sizeof buffer);
+        if (pread(fd, buffer, static_cast<size_t>(size), end - size) != size) return false;
+        for (auto i = size; i > 0; i--) {
+          if (buffer[i - 1] == '\n') {
+            auto const keep = end - size + i;
+            return keep == st.st_size || ftruncate(fd, keep) == 0;
+          }
+        }
+        end -= size;
+      }
+      return st.st_size == 0 || ftruncate(fd, 0) == 0;
+    }
+
+    // One write per line, so a line is either all there or (if we die) missing its newline
+    void record(batch_outcome const &outcome) {
+      auto const status = !outcome.ok ? "failed" : outcome.truncated ? "truncated" : "ok";
+      auto const line = std::string(status) + "\t" + escape(outcome.library) + "\t"
+                        + escape(outcome.output) + "\t" + escape(outcome.error) + "\n";
+      auto const n = write(fd, line.data(), line.size());
+      if (n != static_cast<ssize_t>(line.size()) || fdatasync(fd) != 0) {
+        throw std::runtime_error{"Cannot write to the journal"};
+      }
+    }
+  };
+
+  // The last complete record of every library in a journal
+  std::unordered_map<std::string, batch_outcome> read_journal(std::string const &path) {
+    std::unordered_map<std::string, batch_outcome> finished;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+      // The last line has no newline if we were interrupted while writing it
+      if (in.eof()) break;
+      auto const fields = split_fields(line);
+      auto const &status = fields[0];
+      if (fields.size() != 4 || (status != "ok" && status != "truncated" && status != "failed")) {
+        continue;
+      }
+      batch_outcome outcome{fields[1], fields[2], status != "failed", status == "truncated",
+                            fields[3]};
+      finished[outcome.library] = std::move(outcome);
+    }
+    return finished;
+  }
+
+  bool send_all(int fd, void const *data, size_t size) {
+    auto const *p = static_cast<char const *>(data);
+    while (size > 0) {
+      auto const n = send(fd, p, size, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      p += n;
+      size -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  bool recv_all(int fd, void *data, size_t size) {
+    auto *p = static_cast<char *>(data);
+    while (size > 0) {
+      auto const n = recv(fd, p, size, 0);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      p += n;
+      size -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  // What a worker sends back after each library, followed by the error message
+  struct result_header {
+    std::uint32_t ok;
+    std::uint32_t truncated;
+    std::uint32_t error_size;
+    std::uint64_t rss;
+  };
+
+  // The loop of a worker process: parse the items it is sent until the socket closes
+  [[noreturn]] void worker_main(int fd, std::vector<batch_item> const &items,
+                                batch_options const &options, size_t threads) {
+    // The workers share the cores between them
+    tbb::global_control limit(tbb::global_control::max_allowed_parallelism, threads);
+    std::uint32_t index;
+    while (recv_all(fd, &index, sizeof index) && index < items.size()) {
+      auto const outcome = run_one(items[index], options, nullptr);
+      result_header header{outcome.ok, outcome.truncated,
+                           static_cast<std::uint32_t>(outcome.error.size()),
+                           memory::current_rss()};
+      if (!send_all(fd, &header, sizeof header)
+          || !send_all(fd, outcome.error.data(), outcome.error.size())) {
+        break;
+      }
+    }
+    _exit(0);
+  }
+
+  class WorkerPool {
+    struct worker {
+      pid_t pid = -1;
+      int fd = -1;
+      long item = -1;
+      clock::time_point started;
+    };
+
+    std::vector<batch_item> const &items;
+    batch_options const &options;
+    std::vector<worker> workers;
+
+    void spawn(worker &w) {
+      int fds[2];
+      if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        throw std::runtime_error{"Cannot create a socket for a worker"};
+      }
+
+      // Flush first, or the child would write out our buffers again
+      std::cout.flush();
+      std::cerr.flush();
+      auto const pid = fork();
+      if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        throw std::runtime_error{"Cannot fork a worker"};
+      }
+      if (pid == 0) {
+        // Siblings must not hold on to the other ends, or they never see EOF
+        for (auto const &other : workers) {
+          if (other.fd >= 0) close(other.fd);
+        }
+        close(fds[0]);
+        auto const cores = std::max(1u, std::thread::hardware_concurrency());
+        worker_main(fds[1], items, options, std::max<size_t>(1, cores / workers.size()));
+      }
+      close(fds[1]);
+      w = {pid, fds[0], -1, {}};
+    }
+
+    // Close the socket (the worker exits) and return how the worker ended
+    int retire(worker &w) {
+      close(w.fd);
+      int status = 0;
+      while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR) {
+      }
+      w = {};
+      return status;
+    }
+
+  public:
+    WorkerPool(std::vector<batch_item> const &_items, batch_options const &_options)
+        : items(_items), options(_options), workers(std::min(options.workers, items.size())) {
+      for (auto &w : workers) {
+        spawn(w);
+      }
+    }
+
+    ~WorkerPool() {
+      for (auto &w : workers) {
+        if (w.pid > 0) retire(w);
+      }
+    }
+
+    WorkerPool(WorkerPool const &) = delete;
+    WorkerPool &operator=(WorkerPool const &) = delete;
+
+    std::vector<batch_outcome> run(std::vector<std::uint64_t> const &costs,
+                                   std::function<void(batch_outcome const &)> const &finished) {
+      std::vector<batch_outcome> outcomes(items.size());
+      size_t next = 0, done = 0;
+
+      // Hand out the biggest libraries first, so none of them is left for the end
+      std::vector<std::uint32_t> order(items.size());
+      std::iota(order.begin(), order.end(), std::uint32_t{0});
+      std::stable_sort(order.begin(), order.end(), [&costs](auto a, auto b) {
+        return costs[a] > costs[b];
+      });
+
+      auto assign = [&](worker &w) {
+        while (next < items.size()) {
+          auto const index = order[next++];
+          if (send_all(w.fd, &index, sizeof index)) {
+            w.item = index;
+            w.started = clock::now();
+            return;
+          }
+          // The worker is gone before it got any work, so try again with a new one
+          next--;
+          retire(w);
+          spawn(w);
+        }
+      };
+      for (auto &w : workers) {
+        assign(w);
+      }
+
+      // A worker that ignores its timeout this long is stuck inside Dyninst
+      auto const timeout = options.timeout;
+      auto const kill_after = 2 * timeout;
+
+      std::vector<pollfd> fds;
+      std::vector<worker *> polled;
+      while (done < items.size()) {
+        fds.clear();
+        polled.clear();
+        auto wait = -1;
+        auto const now = clock::now();
+        for (auto &w : workers) {
+          if (w.item >= 0) {
+            fds.push_back({w.fd, POLLIN, 0});
+            polled.push_back(&w);
+            if (timeout.count() > 0) {
+              auto const left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  w.started + kill_after - now);
+              auto const ms = static_cast<int>(std::max<long long>(left.count(), 0) + 1);
+              wait = wait < 0 ? ms : std::min(wait, ms);
+            }
+          }
+        }
+        if (poll(fds.data(), fds.size(), wait) < 0) {
+          if (errno == EINTR) continue;
+          throw std::runtime_error{"Cannot wait for the batch workers"};
+        }
+
+        // Kill the workers that are overdue and have not answered
+        for (size_t i = 0; timeout.count() > 0 && i < fds.size(); i++) {
+          auto &w = *polled[i];
+          if (fds[i].revents != 0 || clock::now() < w.started + kill_after) continue;
+          auto &outcome = outcomes[w.item];
+          outcome.library = items[w.item].library;
+          outcome.output = items[w.item].output;
+          outcome.error = "Timed out, the worker was killed after "
+                          + std::to_string(kill_after.count()) + " ms";
+          done++;
+          finished(outcome);
+          ::kill(w.pid, SIGKILL);
+          retire(w);
+          spawn(w);
+          assign(w);
+        }
+
+        for (size_t i = 0; i < fds.size(); i++) {
+          if (fds[i].revents == 0) continue;
+          auto &w = *polled[i];
+          auto &outcome = outcomes[w.item];
+          outcome.library = items[w.item].library;
+          outcome.output = items[w.item].output;
+          done++;
+
+          result_header header{};
+          if (recv_all(w.fd, &header, sizeof header)) {
+            outcome.ok = header.ok;
+            outcome.truncated = header.truncated;
+            outcome.error.resize(header.error_size);
+            recv_all(w.fd, outcome.error.data(), outcome.error.size());
+            auto const memory_limit = options.worker_memory_limit;
+            if (memory_limit && header.rss > memory_limit) {
+              retire(w);
+              spawn(w);
+            }
+          } else {
+            // The worker died while parsing this library
+            auto const status = retire(w);
+            if (WIFSIGNALED(status)) {
+              outcome.error = std::string("Worker crashed: ") + strsignal(WTERMSIG(status));
+            } else {
+              outcome.error = "Worker exited with status " + std::to_string(WEXITSTATUS(status));
+            }
+            spawn(w);
+          }
+          finished(outcome);
+          w.item = -1;
+          assign(w);
+        }
+      }
+      return outcomes;
+    }
+  };
+}  // namespace
+
+std::vector<batch_outcome> smeagle::runBatch(std::vector<batch_item> const &items,
+                                             batch_options const &options, Stats *stats) {
+  std::vector<batch_outcome> outcomes(items.size());
+
+  // Keep what the journal has finished, as long as its output is still there
+  std::vector<batch_item> todo;
+  std::vector<size_t> positions;
+  std::unordered_map<std::string, batch_outcome> journaled;
+  if (options.resume && !options.journal.empty()) {
+    journaled = read_journal(options.journal);
+  }
+  for (size_t i = 0; i < items.size(); i++) {
+    auto const found = journaled.find(items[i].library);
+    if (found != journaled.end() && found->second.ok && found->second.output == items[i].output
+        && std::filesystem::exists(items[i].output)) {
+      outcomes[i] = found->second;
+      continue;
+    }
+    todo.push_back(items[i]);
+    positions.push_back(i);
+  }
+
+  std::optional<Journal> journal;
+  if (!options.journal.empty()) {
+    journal.emplace(options.journal, options.resume);
+  }
+  std::mutex journal_lock;
+  auto finished = [&journal, &journal_lock](batch_outcome const &outcome) {
+    std::lock_guard<std::mutex> guard(journal_lock);
+    if (journal) journal->record(outcome);
+  };
+
+  std::vector<std::uint64_t> costs;
+  for (auto const &item : todo) {
+    costs.push_back(parse_cost(item.library));
+  }
+
+  std::vector<batch_outcome> results(todo.size());
+  if (options.workers > 0 && !todo.empty()) {
+    WorkerPool pool(todo, options);
+    results = pool.run(costs, finished);
+  } else {
+    // Libraries and their symbols share the threads of one scheduler
+    largest_first(costs, [&](size_t i) {
+      results[i] = run_one(todo[i], options, stats);
+      finished(results[i]);
+    });
+  }
+
+  for (size_t i = 0; i < results.size(); i++) {
+    outcomes[positions[i]] = std::move(results[i]);
+  }
+  return outcomes;
+}
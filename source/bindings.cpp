@@ -0,0 +1,123 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/bindings.h"
+
+#include <iterator>
+#include <ostream>
+
+#include "json.hpp"
+#include "smeagle/trace.h"
+
+using namespace smeagle;
+
+SymbolResolver::SymbolResolver(std::vector<Corpus const *> _scope) : scope(std::move(_scope)) {
+  SMEAGLE_TRACE_SPAN("bindings", "index");
+  size_t exports = 0;
+  for (auto const *corpus : scope) {
+    exports += corpus->getExports().size();
+  }
+  index.reserve(exports);
+
+  // Candidates for a name end up in search order
+  for (size_t i = 0; i < scope.size(); i++) {
+    for (auto const &symbol : scope[i]->getExports()) {
+      index[symbol.name].push_back({i, &symbol});
+    }
+  }
+}
+
+std::vector<symbol_binding> SymbolResolver::resolve(Corpus const &importer) const {
+  SMEAGLE_TRACE_SPAN("bindings", "resolve", importer.getLibrary());
+  std::vector<symbol_binding> bindings;
+  bindings.reserve(importer.getImports().size());
+
+  for (auto const &import : importer.getImports()) {
+    symbol_binding binding{importer.getLibrary(), import.name, import.version, {}, {}};
+
+    abi_dynamic_symbol const *match = nullptr;
+    std::string other_version;
+    if (auto found = index.find(import.name); found != index.end()) {
+      for (auto const &c : found->second) {
+        auto const matches
+            = import.version.empty() ? c.symbol->is_default : c.symbol->version == import.version;
+        if (matches) {
+          match = c.symbol;
+          binding.provider = scope[c.provider]->getLibrary();
+          break;
+        }
+        if (other_version.empty()) other_version = c.symbol->version;
+      }
+    }
+
+    if (!match) {
+      if (!other_version.empty()) {
+        binding.problems.push_back("version " + import.version + " is not provided (found "
+                                   + other_version + ")");
+      } else if (import.is_weak) {
+        binding.problems.push_back("weak reference is not provided");
+      } else {
+        binding.problems.push_back("not provided");
+      }
+    } else {
+      if (!import.kind.empty() && !match->kind.empty() && import.kind != match->kind) {
+        binding.problems.push_back("expected a " + import.kind + ", provider has a "
+                                   + match->kind);
+      }
+      if (import.kind == "variable" && import.size && match->size
+          && import.size != match->size) {
+        binding.problems.push_back("expected " + std::to_string(import.size)
+                                   + " bytes, provider has " + std::to_string(match->size));
+      }
+    }
+    bindings.push_back(std::move(binding));
+  }
+  return bindings;
+}
+
+std::vector<symbol_binding> SymbolResolver::resolveAll() const {
+  std::vector<symbol_binding> bindings;
+  for (auto const *corpus : scope) {
+    auto resolved = resolve(*corpus);
+    bindings.insert(bindings.end(), std::make_move_iterator(resolved.begin()),
+                    std::make_move_iterator(resolved.end()));
+  }
+  return bindings;
+}
+
+void SymbolResolver::toJson(std::vector<symbol_binding> const &bindings, std::ostream &out,
+                            bool problems_only) {
+  size_t problems = 0;
+  out << "{\n\"bindings\": [";
+  auto first = true;
+  for (auto const &b : bindings) {
+    if (!b.problems.empty()) problems++;
+    if (problems_only && b.problems.empty()) continue;
+
+    out << (first ? "\n" : ",\n") << "  {\"library\": ";
+    first = false;
+    json::write_string(out, b.library);
+    out << ", \"symbol\": ";
+    json::write_string(out, b.symbol);
+    if (!b.version.empty()) {
+      out << ", \"version\": ";
+      json::write_string(out, b.version);
+    }
+    if (!b.provider.empty()) {
+      out << ", \"provider\": ";
+      json::write_string(out, b.provider);
+    }
+    if (!b.problems.empty()) {
+      out << ", \"problems\": [";
+      for (size_t i = 0; i < b.problems.size(); i++) {
+        if (i) out << ", ";
+        json::write_string(out, b.problems[i]);
+      }
+      out << "]";
+    }
+    out << "}";
+  }
+  out << "\n],\n\"total\": " << bindings.size() << ",\n\"problems\": " << problems << "\n}\n";
+}
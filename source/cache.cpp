@@ -0,0 +1,121 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/cache.h"
+
+#include <sys/stat.h>
+
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+using namespace smeagle;
+
+namespace {
+  struct file_identity {
+    std::uint64_t device, inode, size;
+    std::int64_t mtime_ns;
+  };
+
+  file_identity identify(std::string const &path) {
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) {
+      throw std::runtime_error{"Cannot stat '" + path + "'"};
+    }
+    return {static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino),
+            static_cast<std::uint64_t>(st.st_size),
+            static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec};
+  }
+}  // namespace
+
+Corpus const &CorpusCache::Entry::corpus() {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!parsed) {
+    parsed.emplace(smeagle.parse());
+  }
+  return *parsed;
+}
+
+bool CorpusCache::Entry::hasExceptions() {
+  std::lock_guard<std::mutex> guard(lock);
+  if (!exceptions) {
+    exceptions = smeagle.has_exceptions();
+  }
+  return *exceptions;
+}
+
+CorpusCache::CorpusCache(size_t _capacity) : capacity(_capacity ? _capacity : 1) {
+  counters.capacity = capacity;
+}
+
+std::shared_ptr<CorpusCache::Entry> CorpusCache::get(std::string const &path) {
+  std::error_code ec;
+  auto const canonical = std::filesystem::canonical(path, ec).string();
+  if (ec) {
+    throw std::runtime_error{"Cannot find library '" + path + "'"};
+  }
+  auto const id = identify(canonical);
+
+  // Entries that are dropped are only destroyed (closing their Symtab) outside of the lock
+  std::vector<std::shared_ptr<Entry>> dropped;
+  std::lock_guard<std::mutex> guard(lock);
+
+  if (auto found = index.find(canonical); found != index.end()) {
+    auto &entry = found->second->second;
+    if (entry->device == id.device && entry->inode == id.inode && entry->size == id.size
+        && entry->mtime_ns == id.mtime_ns) {
+      counters.hits++;
+      lru.splice(lru.begin(), lru, found->second);
+      return entry;
+    }
+
+    // The library was rebuilt since we opened it
+    counters.invalidations++;
+    released.emplace(canonical, entry);
+    dropped.push_back(std::move(entry));
+    lru.erase(found->second);
+    index.erase(found);
+  }
+
+  counters.misses++;
+  for (auto it = released.begin(); it != released.end();) {
+    it = it->second.expired() ? released.erase(it) : std::next(it);
+  }
+  auto entry = released.count(canonical) ? std::make_shared<Entry>(canonical, read_file(canonical))
+                                         : std::make_shared<Entry>(canonical);
+  entry->device = id.device;
+  entry->inode = id.inode;
+  entry->size = id.size;
+  entry->mtime_ns = id.mtime_ns;
+  lru.emplace_front(canonical, entry);
+  index[canonical] = lru.begin();
+
+  if (lru.size() > capacity) {
+    counters.evictions++;
+    index.erase(lru.back().first);
+    released.emplace(lru.back().first, lru.back().second);
+    dropped.push_back(std::move(lru.back().second));
+    lru.pop_back();
+  }
+  return entry;
+}
+
+cache_stats CorpusCache::stats() const {
+  std::lock_guard<std::mutex> guard(lock);
+  auto result = counters;
+  result.entries = lru.size();
+  return result;
+}
+
+void CorpusCache::toJson(std::ostream &out) const {
+  auto const s = stats();
+  out << "{\"hits\": " << s.hits << ", \"misses\": " << s.misses
+      << ", \"evictions\": " << s.evictions << ", \"invalidations\": " << s.invalidations
+      << ", \"entries\": " << s.entries << ", \"capacity\": " << s.capacity << "}";
+}
@@ -0,0 +1,314 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/closure.h"
+
+#include <elf.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include "json.hpp"
+#include "largest_first.hpp"
+#include "smeagle/elf.h"
+#include "smeagle/trace.h"
+
+using namespace smeagle;
+namespace fs = std::filesystem;
+
+namespace {
+  // Split a colon separated search path, dropping empty entries
+  std::vector<std::string> split_path(std::string const &value) {
+    std::vector<std::string> dirs;
+    std::istringstream in(value);
+    for (std::string dir; std::getline(in, dir, ':');) {
+      if (!dir.empty()) dirs.push_back(dir);
+    }
+    return dirs;
+  }
+
+  // Expand $ORIGIN and $LIB (with or without braces) in a search path
+  std::string expand(std::string dir, std::string const &origin, bool is64) {
+    auto replace = [&dir](std::string const &token, std::string const &value) {
+      for (auto const &form : {"${" + token + "}", "$" + token}) {
+        for (auto pos = dir.find(form); pos != std::string::npos; pos = dir.find(form, pos)) {
+          dir.replace(pos, form.size(), value);
+          pos += value.size();
+        }
+      }
+    };
+    replace("ORIGIN", origin);
+    replace("LIB", is64 ? "lib64" : "lib");
+    return dir;
+  }
+
+  /**
+   * The entries of /etc/ld.so.cache, in the order ld.so looks at them
+   *
+   * Only the new format ("glibc-ld.so.cache1.1") is read, either on its
+   * own or after the entries of the old format.
+   */
+  std::vector<std::pair<std::string, std::string>> read_ld_cache(std::string const &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::string const data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    constexpr char old_magic[] = "ld.so-1.7.0";
+    constexpr char new_magic[] = "glibc-ld.so.cache1.1";
+    size_t start = 0;
+    if (data.compare(0, sizeof old_magic - 1, old_magic) == 0 && data.size() >= 16) {
+      std::uint32_t count;
+      std::memcpy(&count, data.data() + 12, sizeof count);
+      start = (16 + static_cast<size_t>(count) * 12 + 7) & ~size_t{7};
+    }
+    if (data.size() < start + 48 || data.compare(start, sizeof new_magic - 1, new_magic) != 0) {
+      return {};
+    }
+
+    std::uint32_t count;
+    std::memcpy(&count, data.data() + start + 20, sizeof count);
+
+    // Offsets of the strings are relative to the start of the new format
+    std::string_view const strings(data.data() + start, data.size() - start);
+    auto string_at = [&strings](std::uint32_t offset) {
+      return std::string(elf::string_at(strings, offset));
+    };
+
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (size_t i = 0; i < count; i++) {
+      auto const entry = start + 48 + i * 24;
+      if (entry + 24 > data.size()) break;
+      std::uint32_t key, value;
+      std::memcpy(&key, data.data() + entry + 4, sizeof key);
+      std::memcpy(&value, data.data() + entry + 8, sizeof value);
+      entries.emplace_back(string_at(key), string_at(value));
+    }
+    return entries;
+  }
+
+  std::vector<std::pair<std::string, std::string>> const &ld_cache() {
+    static auto const entries = read_ld_cache("/etc/ld.so.cache");
+    return entries;
+  }
+
+  class Resolver {
+    bool is64;
+    std::uint16_t machine;
+    std::vector<std::string> root_rpath;
+    std::vector<std::string> library_path;
+
+    // Is this an ELF object that the root binary could load?
+    bool compatible(std::string const &candidate) const {
+      if (!elf::has_magic(candidate)) return false;
+      try {
+        elf::File file(candidate);
+        return file.is_64bit() == is64 && file.machine() == machine;
+      } catch (std::runtime_error const &) {
+        return false;
+      }
+    }
+
+    std::string search(std::string const &name, std::vector<std::string> const &dirs) const {
+      for (auto const &dir : dirs) {
+        auto const candidate = dir + "/" + name;
+        if (compatible(candidate)) return candidate;
+      }
+      return {};
+    }
+
+  public:
+    explicit Resolver(elf::File const &root)
+        : is64(root.is_64bit()), machine(root.machine()) {
+      auto const origin = fs::path(root.name()).parent_path().string();
+      if (root.runpath().empty()) {
+        for (auto const &dir : split_path(root.rpath())) {
+          root_rpath.push_back(expand(dir, origin, is64));
+        }
+      }
+      if (auto const *value = std::getenv("LD_LIBRARY_PATH")) {
+        library_path = split_path(value);
+      }
+    }
+
+    // Find one DT_NEEDED entry of an object, empty if it cannot be found
+    std::string resolve(std::string const &name, elf::File const &object) const {
+      if (name.find('/') != std::string::npos) {
+        return compatible(name) ? name : std::string{};
+      }
+
+      auto const origin = fs::path(object.name()).parent_path().string();
+      auto const runpath = split_path(object.runpath());
+      std::vector<std::string> dirs;
+      if (runpath.empty()) {
+        for (auto const &dir : split_path(object.rpath())) {
+          dirs.push_back(expand(dir, origin, is64));
+        }
+        dirs.insert(dirs.end(), root_rpath.begin(), root_rpath.end());
+      }
+      dirs.insert(dirs.end(), library_path.begin(), library_path.end());
+      for (auto const &dir : runpath) {
+        dirs.push_back(expand(dir, origin, is64));
+      }
+      if (auto found = search(name, dirs); !found.empty()) return found;
+
+      for (auto const &[soname, path] : ld_cache()) {
+        if (soname == name && compatible(path)) return path;
+      }
+
+      if (is64) {
+        return search(name, {"/lib64", "/usr/lib64"});
+      }
+      return search(name, {"/lib", "/usr/lib"});
+    }
+  };
+}  // namespace
+
+DependencyGraph smeagle::resolveDependencies(std::string const &path) {
+  SMEAGLE_TRACE_SPAN("closure", "resolve", path);
+  std::error_code ec;
+  auto const root = fs::canonical(path, ec).string();
+  if (ec) {
+    throw std::runtime_error{"Cannot find '" + path + "'"};
+  }
+
+  DependencyGraph graph;
+  graph.root = root;
+
+  auto root_file = std::make_unique<elf::File>(root);
+  Resolver const resolver(*root_file);
+
+  std::set<std::string> seen{root};
+  std::deque<std::string> queue{root};
+  while (!queue.empty()) {
+    auto const current = queue.front();
+    queue.pop_front();
+    graph.libraries.push_back(current);
+
+    auto file = current == root ? std::move(root_file) : std::make_unique<elf::File>(current);
+    auto &needed = graph.needed[current];
+    for (auto const &name : file->needed()) {
+      auto found = resolver.resolve(name, *file);
+      if (found.empty()) {
+        graph.missing[current].push_back(name);
+        continue;
+      }
+      auto library = fs::canonical(found, ec).string();
+      if (ec) {
+        graph.missing[current].push_back(name);
+        continue;
+      }
+      needed.push_back(library);
+      if (seen.insert(library).second) {
+        queue.push_back(library);
+      }
+    }
+  }
+  return graph;
+}
+
+Closure::Closure(DependencyGraph _graph) : graph(std::move(_graph)) {}
+
+Closure::~Closure() {
+  // The corpora refer to types of the open objects
+  corpora.clear();
+  for (auto &smeagle : opened) {
+    smeagle->close();
+  }
+}
+
+void Closure::parse(Stats *stats) {
+  auto const &libraries = graph.libraries;
+  opened.clear();
+  for (auto const &library : libraries) {
+    opened.push_back(std::make_unique<Smeagle>(library));
+    opened.back()->setStats(stats);
+    opened.back()->setTypeCache(&types);
+  }
+
+  // Every task only touches its own slot
+  std::vector<std::optional<Corpus>> parsed(libraries.size());
+  std::vector<std::string> failures(libraries.size());
+  std::vector<std::uint64_t> costs;
+  for (auto const &library : libraries) {
+    try {
+      costs.push_back(elf::File(library).parse_cost());
+    } catch (std::runtime_error const &) {
+      costs.push_back(0);
+    }
+  }
+  largest_first(costs, [&](size_t i) {
+    SMEAGLE_TRACE_SPAN("closure", "library", libraries[i]);
+    try {
+      parsed[i].emplace(opened[i]->parse());
+    } catch (std::exception const &e) {
+      failures[i] = e.what();
+    }
+  });
+
+  corpora.clear();
+  errors.clear();
+  for (size_t i = 0; i < libraries.size(); i++) {
+    if (parsed[i]) {
+      corpora.emplace(libraries[i], std::move(*parsed[i]));
+    } else {
+      errors.emplace(libraries[i], failures[i]);
+    }
+  }
+}
+
+void Closure::toJson(std::ostream &out) const {
+  auto write_lists = [&out](std::map<std::string, std::vector<std::string>> const &lists) {
+    out << "{";
+    auto first = true;
+    for (auto const &[library, values] : lists) {
+      out << (first ? "\n" : ",\n") << "  ";
+      first = false;
+      json::write_string(out, library);
+      out << ": [";
+      for (size_t i = 0; i < values.size(); i++) {
+        if (i) out << ", ";
+        json::write_string(out, values[i]);
+      }
+      out << "]";
+    }
+    out << "\n}";
+  };
+
+  out << "{\n\"root\": ";
+  json::write_string(out, graph.root);
+  out << ",\n\"needed\": ";
+  write_lists(graph.needed);
+  out << ",\n\"missing\": ";
+  write_lists(graph.missing);
+
+  out << ",\n\"errors\": {";
+  auto first = true;
+  for (auto const &[library, error] : errors) {
+    out << (first ? "\n" : ",\n") << "  ";
+    first = false;
+    json::write_string(out, library);
+    out << ": ";
+    json::write_string(out, error);
+  }
+  out << "\n},\n\"corpora\": {";
+  first = true;
+  for (auto const &[library, corpus] : corpora) {
+    out << (first ? "\n" : ",\n");
+    first = false;
+    json::write_string(out, library);
+    out << ":\n";
+    corpus.toJson(out);
+  }
+  out << "\n}\n}\n";
+}
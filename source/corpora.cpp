@@ -5,94 +5,511 @@
 
 #include "smeagle/corpora.h"
 
+#include <cstdint>
 #include <cstdio>
 #include <iostream>
+#include <iterator>
+#include <optional>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 
 #include "Symtab.h"
+#include "json.hpp"
+#include "mapped_file.hpp"
+#include "smeagle/trace.h"
 #include "parser/aarch64/aarch64.hpp"
 #include "parser/ppc64le/ppc64le.hpp"
 #include "parser/x86_64/x86_64.hpp"
 
 using namespace smeagle;
 
+namespace {
+  // Forward output to another stream buffer, counting the bytes that pass through
+  class counting_streambuf : public std::streambuf {
+    std::streambuf *dest;
+    std::uint64_t count = 0;
+
+  public:
+    explicit counting_streambuf(std::streambuf *_dest) : dest(_dest) {}
+    std::uint64_t bytes() const { return count; }
+
+  protected:
+    int_type overflow(int_type ch) override {
+      if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+      }
+      count++;
+      return dest->sputc(traits_type::to_char_type(ch));
+    }
+    std::streamsize xsputn(char const *s, std::streamsize n) override {
+      auto written = dest->sputn(s, n);
+      count += written;
+      return written;
+    }
+    int sync() override { return dest->pubsync(); }
+  };
+
+  // dump imports or exports, one symbol per line
+  void symbolsToJson(std::vector<abi_dynamic_symbol> const &symbols, std::ostream &out) {
+    for (auto const &s : symbols) {
+      out << "   {\"name\": ";
+      json::write_string(out, s.name);
+      if (!s.version.empty()) {
+        out << ", \"version\": ";
+        json::write_string(out, s.version);
+      }
+      if (!s.version_file.empty()) {
+        out << ", \"version_file\": ";
+        json::write_string(out, s.version_file);
+      }
+      if (!s.kind.empty()) out << ", \"kind\": \"" << s.kind << "\"";
+      if (s.size) out << ", \"size\": " << s.size;
+      if (s.is_weak) out << ", \"weak\": true";
+      if (!s.is_default) out << ", \"default\": false";
+      out << "}" << (&s == &symbols.back() ? "" : ",") << "\n";
+    }
+  }
+
+  // A parameter read back from a corpus, which is written as it was read
+  struct stored_parameter {
+    std::string name_;
+    std::string type_name_;
+    std::string class_name_;
+    std::string direction_;
+    std::string location_;
+    size_t size_in_bytes_ = 0;
+    std::string text_;  // the whole object, with the fields of aggregates
+
+    std::string name() const { return name_; }
+    std::string type_name() const { return type_name_; }
+    std::string class_name() const { return class_name_; }
+    std::string direction() const { return direction_; }
+    std::string location() const { return location_; }
+    size_t size_in_bytes() const { return size_in_bytes_; }
+    void toJson(std::ostream &out, int indent) const {
+      out << std::string(indent, ' ') << text_;
+    }
+  };
+
+  parameter read_parameter(json::cursor &in) {
+    stored_parameter p;
+    p.text_ = in.raw([&]() {
+      in.object([&](std::string_view key) {
+        if (key == "name") {
+          p.name_ = in.string();
+        } else if (key == "type") {
+          p.type_name_ = in.string();
+        } else if (key == "class") {
+          p.class_name_ = in.string();
+        } else if (key == "direction") {
+          p.direction_ = in.string();
+        } else if (key == "location") {
+          p.location_ = in.string();
+        } else if (key == "size") {
+          p.size_in_bytes_ = static_cast<size_t>(in.number());
+        } else {
+          in.skip();
+        }
+      });
+    });
+    return parameter(std::move(p));
+  }
+
+  abi_dynamic_symbol read_symbol(json::cursor &in) {
+    abi_dynamic_symbol s;
+    in.object([&](std::string_view key) {
+      if (key == "name") {
+        s.name = in.string();
+      } else if (key == "version") {
+        s.version = in.string();
+      } else if (key == "version_file") {
+        s.version_file = in.string();
+      } else if (key == "kind") {
+        s.kind = in.string();
+      } else if (key == "size") {
+        s.size = static_cast<unsigned>(in.number());
+      } else if (key == "weak") {
+        s.is_weak = in.boolean();
+      } else if (key == "default") {
+        s.is_default = in.boolean();
+      } else {
+        in.skip();
+      }
+    });
+    return s;
+  }
+
+  // Fill in the fields shared by imports and exports
+  abi_dynamic_symbol describe(Dyninst::SymtabAPI::Symbol *symbol) {
+    abi_dynamic_symbol description;
+    description.name = symbol->getMangledName();
+    std::vector<std::string> *versions = nullptr;
+    if (symbol->getVersions(versions) && versions && !versions->empty()) {
+      description.version = versions->front();
+    }
+    description.size = symbol->getSize();
+    switch (symbol->getType()) {
+      case Dyninst::SymtabAPI::Symbol::ST_FUNCTION:
+      case Dyninst::SymtabAPI::Symbol::ST_INDIRECT:
+        description.kind = "function";
+        break;
+      case Dyninst::SymtabAPI::Symbol::ST_OBJECT:
+      case Dyninst::SymtabAPI::Symbol::ST_TLS:
+        description.kind = "variable";
+        break;
+      default:
+        break;
+    }
+    description.is_weak = symbol->getLinkage() == Dyninst::SymtabAPI::Symbol::SL_WEAK;
+    return description;
+  }
+}  // namespace
+
 Corpus::Corpus(std::string _library) : library(std::move(_library)){};
 
 // dump all Type Locations to json
-void Corpus::toJson() {
-  // ensure that we can replace already written characters (buffered output)
-  std::ios::sync_with_stdio(false);
-  std::cout << "{\n"
-            << " \"library\": \"" << library << "\",\n"
-            << " \"locations\":\n"
-            << " [\n";
+void Corpus::toJson(std::ostream &dest, Stats *stats,
+                    CancellationToken const *cancellation) const {
+  SMEAGLE_TRACE_SPAN("serialize", "toJson", library);
+  PhaseTimer timer(stats, Phase::Serialize);
+
+  // Only pay for counting the bytes when somebody is looking
+  counting_streambuf counter(dest.rdbuf());
+  std::ostream counted(&counter);
+  std::ostream &out = stats ? counted : dest;
+
+  CorpusWriter writer(out, library);
+  writer.addLocations(*this, cancellation);
+  writer.finish(*this);
+  if (stats) {
+    stats->add(Counter::Errors, writer.writeErrors());
+    stats->add(Counter::Bytes, counter.bytes());
+  }
+}
+
+CorpusWriter::CorpusWriter(std::ostream &_out, std::string const &library) : out(_out) {
+  out << "{\n"
+      << " \"library\": \"" << library << "\",\n"
+      << " \"locations\":\n"
+      << " [\n";
+}
+
+bool CorpusWriter::addLocations(Corpus const &part, CancellationToken const *cancellation,
+                                RenderedPart *rendered) {
+  // A corpus that was truncated while parsing is written whole, and marked
+  auto should_stop = [this, cancellation]() {
+    stopped = stopped || (cancellation && cancellation->stopRequested());
+    return stopped;
+  };
+
+  // Entries are separated, not terminated, by commas
+  auto separate = [this]() {
+    out << (first ? "" : ",\n");
+    first = false;
+  };
+
+  std::ostringstream entry;
+  if (rendered) {
+    rendered->errors = part.getErrors();
+  }
 
   // Parsing of variables first
-  for (auto &v : variables) {
-    std::string endcomma;
-
-    // If we are at the last variable AND there are no functions
-    if (&v == &variables.back() && functions.size() == 0)
-      endcomma = "";
-    else {
-      endcomma = ",";
-    }
-
-    // Add a new variable type here
-    std::cout << "   {\"variable\": {\n"
-              << "      \"name\": \"" << v.variable_name << "\",\n"
-              << "      \"type\": \"" << v.variable_type << "\",\n"
-              << "      \"size\": \"" << v.variable_size << "\"}}" << endcomma << "\n";
-  }
-
-  // Parsing of functions next
-  for (auto &f : functions) {
-    std::string endcomma;
-    if (&f == &functions.back())
-      endcomma = "";
-    else {
-      endcomma = ",";
-    }
-
-    // We have parameters
-    if (f.parameters.size() > 0) {
-      std::cout << "   {\n"
-                << "    \"function\": {\n"
-                << "      \"name\": \"" << f.function_name << "\",\n"
-                << "      \"parameters\": [\n";
-
-      for (auto const &p : f.parameters) {
-        // Check if we are at the last entry (no comma) or not
-        auto endcomma = (&p == &f.parameters.back()) ? "" : ",";
-        p.toJson(std::cout, 8);
-        std::cout << endcomma << '\n';
+  for (auto &v : part.getVariables()) {
+    if (should_stop()) break;
+    separate();
+    if (rendered) {
+      entry.str("");
+      entry.clear();
+      Corpus::variableToJson(v, entry);
+      out << entry.str();
+      rendered->locations.push_back(entry.str());
+    } else {
+      Corpus::variableToJson(v, out);
+    }
+  }
+
+  // Parsing of functions next. A function that cannot be written is moved
+  // to the errors, so each one is rendered on its own first.
+  for (auto &f : part.getFunctions()) {
+    if (should_stop()) break;
+    entry.str("");
+    entry.clear();
+    try {
+      Corpus::functionToJson(f, entry);
+    } catch (std::exception const &e) {
+      failed.push_back({f.function_name, e.what()});
+      if (rendered) rendered->errors.push_back(failed.back());
+      continue;
+    }
+    separate();
+    out << entry.str();
+    if (rendered) rendered->locations.push_back(entry.str());
+  }
+  truncated = truncated || part.isTruncated();
+  return !stopped;
+}
+
+void CorpusWriter::addRendered(RenderedPart const &part) {
+  for (auto const &location : part.locations) {
+    out << (first ? "" : ",\n") << location;
+    first = false;
+  }
+  failed.insert(failed.end(), part.errors.begin(), part.errors.end());
+}
+
+void CorpusWriter::finish(Corpus const &rest) {
+  if (!first) out << "\n";
+  out << "],\n"
+      << " \"imports\":\n"
+      << " [\n";
+  symbolsToJson(rest.getImports(), out);
+  out << "],\n"
+      << " \"exports\":\n"
+      << " [\n";
+  symbolsToJson(rest.getExports(), out);
+  out << "],\n"
+      << " \"errors\":\n"
+      << " [\n";
+  std::vector<abi_symbol_error> all(rest.getErrors());
+  all.insert(all.end(), failed.begin(), failed.end());
+  for (auto const &e : all) {
+    out << "   {\"symbol\": ";
+    json::write_string(out, e.symbol);
+    out << ", \"reason\": ";
+    json::write_string(out, e.reason);
+    out << "}" << (&e == &all.back() ? "" : ",") << "\n";
+  }
+  out << "]";
+  if (stopped || truncated || rest.isTruncated()) {
+    out << ",\n \"truncated\": true";
+  }
+  out << "\n}" << std::endl;
+}
+
+// dump one variable location (without a trailing comma or newline)
+void Corpus::variableToJson(abi_variable_description const &v, std::ostream &out) {
+  out << "   {\"variable\": {\n"
+      << "      \"name\": \"" << v.variable_name << "\",\n";
+  if (!v.member.empty()) {
+    out << "      \"member\": ";
+    json::write_string(out, v.member);
+    out << ",\n";
+  }
+  out << "      \"type\": \"" << v.variable_type << "\",\n"
+      << "      \"size\": \"" << v.variable_size << "\"}}";
+}
+
+// dump one function location (without a trailing comma or newline)
+void Corpus::functionToJson(abi_function_description const &f, std::ostream &out) {
+  // We have parameters
+  if (f.parameters.size() > 0) {
+    out << "   {\n"
+        << "    \"function\": {\n"
+        << "      \"name\": \"" << f.function_name << "\",\n";
+    if (!f.member.empty()) {
+      out << "      \"member\": ";
+      json::write_string(out, f.member);
+      out << ",\n";
+    }
+    out << "      \"parameters\": [\n";
+
+    for (auto const &p : f.parameters) {
+      // Check if we are at the last entry (no comma) or not
+      auto endcomma = (&p == &f.parameters.back()) ? "" : ",";
+      p.toJson(out, 8);
+      out << endcomma << '\n';
+    }
+    out << "    ]\n";
+  } else {
+    // If we don't have parameters, don't add anything
+    out << "   {\n"
+        << "    \"function\": {\n"
+        << "      \"name\": \"" << f.function_name << "\"";
+    if (!f.member.empty()) {
+      out << ",\n      \"member\": ";
+      json::write_string(out, f.member);
+    }
+  }
+
+  out << ",\n      \"return\": \n";
+  f.return_value.toJson(out, 8);
+  out << "\n    \n";
+
+  out << "   }}";
+}
+
+Corpus Corpus::fromJson(std::string_view text) {
+  json::cursor in(text);
+  Corpus corpus("");
+  bool has_library = false;
+
+  auto read_function = [&]() {
+    std::vector<parameter> parameters;
+    std::optional<parameter> return_value;
+    std::string name, member;
+    in.object([&](std::string_view key) {
+      if (key == "name") {
+        name = in.string();
+      } else if (key == "member") {
+        member = in.string();
+      } else if (key == "parameters") {
+        in.array([&]() { parameters.push_back(read_parameter(in)); });
+      } else if (key == "return") {
+        return_value = read_parameter(in);
+      } else {
+        in.skip();
+      }
+    });
+    if (!return_value) {
+      throw std::runtime_error{"Function '" + name + "' has no return value"};
+    }
+    corpus.functions.emplace_back(std::move(parameters), std::move(*return_value),
+                                  std::move(name));
+    corpus.functions.back().member = std::move(member);
+  };
+
+  auto read_variable = [&]() {
+    abi_variable_description v{};
+    in.object([&](std::string_view key) {
+      if (key == "name") {
+        v.variable_name = in.string();
+      } else if (key == "member") {
+        v.member = in.string();
+      } else if (key == "type") {
+        v.variable_type = in.string();
+      } else if (key == "size") {
+        v.variable_size = static_cast<int>(in.number());
+      } else {
+        in.skip();
       }
-      std::cout << "    ]\n";
+    });
+    corpus.variables.push_back(std::move(v));
+  };
+
+  in.object([&](std::string_view key) {
+    if (key == "library") {
+      corpus.library = in.string();
+      has_library = true;
+    } else if (key == "locations") {
+      in.array([&]() {
+        in.object([&](std::string_view kind) {
+          if (kind == "function") {
+            read_function();
+          } else if (kind == "variable") {
+            read_variable();
+          } else {
+            in.skip();
+          }
+        });
+      });
+    } else if (key == "imports") {
+      in.array([&]() { corpus.imports.push_back(read_symbol(in)); });
+    } else if (key == "exports") {
+      in.array([&]() { corpus.exports.push_back(read_symbol(in)); });
+    } else if (key == "errors") {
+      in.array([&]() {
+        abi_symbol_error e;
+        in.object([&](std::string_view field) {
+          if (field == "symbol") {
+            e.symbol = in.string();
+          } else if (field == "reason") {
+            e.reason = in.string();
+          } else {
+            in.skip();
+          }
+        });
+        corpus.errors.push_back(std::move(e));
+      });
+    } else if (key == "truncated") {
+      corpus.truncated = in.boolean();
     } else {
-      // If we don't have parameters, don't add anything
-      std::cout << "   {\n"
-                << "    \"function\": {\n"
-                << "      \"name\": \"" << f.function_name << "\"";
+      in.skip();
     }
+  });
+  in.finish();
 
-    std::cout << ",\n      \"return\": \n";
-    f.return_value.toJson(std::cout, 8);
-    std::cout << "\n    \n";
+  if (!has_library) {
+    throw std::runtime_error{"Not a corpus, it has no library"};
+  }
+  return corpus;
+}
 
-    std::cout << "   }}" << endcomma << "\n";
+Corpus Corpus::fromJsonFile(std::string const &path) {
+  auto const [base, length] = map_file(path);
+  try {
+    auto corpus = fromJson(std::string_view(base, length));
+    unmap_file(base, length);
+    return corpus;
+  } catch (std::runtime_error const &e) {
+    unmap_file(base, length);
+    throw std::runtime_error{path + ": " + e.what()};
   }
-  std::cout << "]\n"
-            << "}" << std::endl;
+}
+
+bool Corpus::symbolToJson(std::string const &name, std::ostream &out) const {
+  for (auto const &f : functions) {
+    if (f.function_name == name) {
+      functionToJson(f, out);
+      out << "\n";
+      return true;
+    }
+  }
+  for (auto const &v : variables) {
+    if (v.variable_name == name) {
+      variableToJson(v, out);
+      out << "\n";
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t Corpus::retainedSize() const {
+  size_t size = sizeof(*this) + library.capacity();
+  size += functions.capacity() * sizeof(abi_function_description);
+  for (auto const &f : functions) {
+    size += f.function_name.capacity() + f.member.capacity()
+            + f.parameters.capacity() * sizeof(parameter);
+    for (auto const &p : f.parameters) {
+      size += p.retained_size();
+    }
+    size += f.return_value.retained_size();
+  }
+  size += variables.capacity() * sizeof(abi_variable_description);
+  for (auto const &v : variables) {
+    size += v.variable_name.capacity() + v.variable_type.capacity() + v.member.capacity();
+  }
+  size += (imports.capacity() + exports.capacity()) * sizeof(abi_dynamic_symbol);
+  size += errors.capacity() * sizeof(abi_symbol_error);
+  for (auto const &e : errors) {
+    size += e.symbol.capacity() + e.reason.capacity();
+  }
+  for (auto const *symbols : {&imports, &exports}) {
+    for (auto const &s : *symbols) {
+      size += s.name.capacity() + s.version.capacity() + s.version_file.capacity();
+    }
+  }
+  return size;
 }
 
 // parse a function for parameters and abi location
 void Corpus::parseFunctionABILocation(Dyninst::SymtabAPI::Symbol *symbol,
-                                      Dyninst::Architecture arch) {
+                                      Dyninst::Architecture arch, Stats *stats) {
+  SMEAGLE_TRACE_SPAN("classify", symbol->getMangledName());
+  PhaseTimer timer(stats, Phase::Classify);
   switch (arch) {
     case Dyninst::Architecture::Arch_x86_64:
-      functions.emplace_back(x86_64::parse_parameters(symbol), x86_64::parse_return_value(symbol),
-                             symbol->getMangledName());
+      try {
+        functions.emplace_back(x86_64::parse_parameters(symbol, stats),
+                               x86_64::parse_return_value(symbol, stats),
+                               symbol->getMangledName());
+      } catch (std::exception const &e) {
+        errors.push_back({symbol->getMangledName(), e.what()});
+        if (stats) stats->add(Counter::Errors);
+        break;
+      }
+      if (stats) stats->add(Counter::Functions);
       break;
     case Dyninst::Architecture::Arch_aarch64:
       break;
@@ -106,10 +523,19 @@ void Corpus::parseFunctionABILocation(Dyninst::SymtabAPI::Symbol *symbol,
 
 // parse a variable (global) for parameters and abi location
 void Corpus::parseVariableABILocation(Dyninst::SymtabAPI::Symbol *symbol,
-                                      Dyninst::Architecture arch) {
+                                      Dyninst::Architecture arch, Stats *stats) {
+  SMEAGLE_TRACE_SPAN("classify", symbol->getMangledName());
+  PhaseTimer timer(stats, Phase::Classify);
   switch (arch) {
     case Dyninst::Architecture::Arch_x86_64:
-      variables.emplace_back(x86_64::parse_variable(symbol));
+      try {
+        variables.emplace_back(x86_64::parse_variable(symbol));
+      } catch (std::exception const &e) {
+        errors.push_back({symbol->getMangledName(), e.what()});
+        if (stats) stats->add(Counter::Errors);
+        break;
+      }
+      if (stats) stats->add(Counter::Variables);
       break;
     case Dyninst::Architecture::Arch_aarch64:
       break;
@@ -120,3 +546,50 @@ void Corpus::parseVariableABILocation(Dyninst::SymtabAPI::Symbol *symbol,
       break;
   }
 }
+
+// take over the symbols of an archive member
+void Corpus::merge(Corpus &&other, std::string const &member) {
+  for (auto &f : other.functions) {
+    if (!member.empty()) f.member = member;
+    functions.push_back(std::move(f));
+  }
+  for (auto &v : other.variables) {
+    if (!member.empty()) v.member = member;
+    variables.push_back(std::move(v));
+  }
+  for (auto &e : other.errors) {
+    auto symbol = member.empty() ? std::move(e.symbol) : member + ": " + e.symbol;
+    errors.push_back({std::move(symbol), std::move(e.reason)});
+  }
+  imports.insert(imports.end(), std::make_move_iterator(other.imports.begin()),
+                 std::make_move_iterator(other.imports.end()));
+  exports.insert(exports.end(), std::make_move_iterator(other.exports.begin()),
+                 std::make_move_iterator(other.exports.end()));
+  other.functions.clear();
+  other.variables.clear();
+  other.imports.clear();
+  other.exports.clear();
+  other.errors.clear();
+  truncated = truncated || other.truncated;
+}
+
+void Corpus::clearLocations() {
+  functions.clear();
+  functions.shrink_to_fit();
+  variables.clear();
+  variables.shrink_to_fit();
+}
+
+// record an imported symbol and the version it requires
+void Corpus::parseImport(Dyninst::SymtabAPI::Symbol *symbol) {
+  auto description = describe(symbol);
+  symbol->getVersionFileName(description.version_file);
+  imports.push_back(std::move(description));
+}
+
+// record an exported symbol and the version it is defined with
+void Corpus::parseExport(Dyninst::SymtabAPI::Symbol *symbol) {
+  auto description = describe(symbol);
+  description.is_default = !symbol->getVersionHidden();
+  exports.push_back(std::move(description));
+}
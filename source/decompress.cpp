@@ -0,0 +1,142 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/decompress.h"
+
+#include <elf.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace smeagle;
+
+namespace {
+  std::mutex pool_lock;
+  std::vector<std::vector<char>> pool;
+
+  std::uint64_t align(std::uint64_t offset, std::uint64_t alignment) {
+    return alignment > 1 ? (offset + alignment - 1) / alignment * alignment : offset;
+  }
+
+  // A section to decompress, and where it goes in the copy
+  struct inflation {
+    size_t index;
+    std::string_view compressed;
+    std::uint64_t size, alignment, offset;
+  };
+
+  template <typename Chdr>
+  bool read_header(std::string_view contents, inflation &section) {
+    if (contents.size() < sizeof(Chdr)) return false;
+    Chdr header;
+    std::memcpy(&header, contents.data(), sizeof header);
+    if (header.ch_type != ELFCOMPRESS_ZLIB) return false;
+    section.compressed = contents.substr(sizeof header);
+    section.size = header.ch_size;
+    section.alignment = header.ch_addralign;
+    return true;
+  }
+
+  template <typename Ehdr, typename Shdr>
+  void rewrite_headers(std::vector<char> &image, std::vector<inflation> const &sections,
+                       std::uint64_t table_offset) {
+    Ehdr ehdr;
+    std::memcpy(&ehdr, image.data(), sizeof ehdr);
+    for (size_t i = 0; i < ehdr.e_shnum; i++) {
+      std::memmove(image.data() + table_offset + i * sizeof(Shdr),
+                   image.data() + ehdr.e_shoff + i * ehdr.e_shentsize, sizeof(Shdr));
+    }
+    for (auto const &s : sections) {
+      auto *header = image.data() + table_offset + s.index * sizeof(Shdr);
+      Shdr shdr;
+      std::memcpy(&shdr, header, sizeof shdr);
+      shdr.sh_flags &= ~static_cast<decltype(shdr.sh_flags)>(SHF_COMPRESSED);
+      shdr.sh_offset = s.offset;
+      shdr.sh_size = s.size;
+      shdr.sh_addralign = s.alignment;
+      std::memcpy(header, &shdr, sizeof shdr);
+    }
+    ehdr.e_shoff = table_offset;
+    ehdr.e_shentsize = sizeof(Shdr);
+    std::memcpy(image.data(), &ehdr, sizeof ehdr);
+  }
+}  // namespace
+
+std::vector<char> BufferPool::acquire() {
+  std::lock_guard<std::mutex> guard(pool_lock);
+  if (pool.empty()) return {};
+  auto buffer = std::move(pool.back());
+  pool.pop_back();
+  return buffer;
+}
+
+void BufferPool::release(std::vector<char> buffer) {
+  buffer.clear();
+  std::lock_guard<std::mutex> guard(pool_lock);
+  // One per thread that could be opening a library is enough
+  if (pool.size() < std::max(1u, std::thread::hardware_concurrency())) {
+    pool.push_back(std::move(buffer));
+  }
+}
+
+bool elf::decompress_debug_sections(File const &file, std::vector<char> &image) {
+  image.clear();
+  std::vector<inflation> sections;
+  auto const &all = file.sections();
+  for (size_t i = 0; i < all.size(); i++) {
+    auto const &s = all[i];
+    if (!(s.flags & SHF_COMPRESSED) || s.name.rfind(".debug_", 0) != 0) continue;
+    inflation section{i, {}, 0, 0, 0};
+    auto const contents = file.contents(s);
+    if (file.is_64bit() ? read_header<Elf64_Chdr>(contents, section)
+                        : read_header<Elf32_Chdr>(contents, section)) {
+      sections.push_back(section);
+    }
+  }
+  if (sections.empty()) return false;
+
+  // The original bytes stay where they are, so nothing else has to move
+  std::uint64_t end = file.size();
+  for (auto &s : sections) {
+    s.offset = align(end, s.alignment);
+    end = s.offset + s.size;
+  }
+  auto const table_offset = align(end, 8);
+  auto const shdr_size = file.is_64bit() ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr);
+  image.resize(table_offset + all.size() * shdr_size);
+  std::memcpy(image.data(), file.data(), file.size());
+
+  // Each section is one zlib stream, which cannot be split, so the sections
+  // are the unit of work (the largest, .debug_info, usually decides the time)
+  std::sort(sections.begin(), sections.end(),
+            [](auto const &a, auto const &b) { return a.size > b.size; });
+  tbb::this_task_arena::isolate([&]() {
+    tbb::parallel_for(size_t{0}, sections.size(), [&](size_t i) {
+      auto const &s = sections[i];
+      auto length = static_cast<uLongf>(s.size);
+      auto const status
+          = uncompress(reinterpret_cast<Bytef *>(image.data() + s.offset), &length,
+                       reinterpret_cast<Bytef const *>(s.compressed.data()),
+                       static_cast<uLong>(s.compressed.size()));
+      if (status != Z_OK || length != s.size) {
+        throw std::runtime_error{"Cannot decompress " + file.sections()[s.index].name + " of '"
+                                 + file.name() + "'"};
+      }
+    });
+  });
+
+  if (file.is_64bit()) {
+    rewrite_headers<Elf64_Ehdr, Elf64_Shdr>(image, sections, table_offset);
+  } else {
+    rewrite_headers<Elf32_Ehdr, Elf32_Shdr>(image, sections, table_offset);
+  }
+  return true;
+}
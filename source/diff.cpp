@@ -0,0 +1,144 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/diff.h"
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+
+#include "json.hpp"
+
+using namespace smeagle;
+
+namespace {
+  // The json description of every symbol in a corpus, keyed by mangled name
+  struct symbol_index {
+    std::unordered_map<std::string, abi_function_description const *> functions;
+    std::unordered_map<std::string, abi_variable_description const *> variables;
+
+    explicit symbol_index(Corpus const &corpus) {
+      for (auto const &f : corpus.getFunctions()) functions.emplace(f.function_name, &f);
+      for (auto const &v : corpus.getVariables()) variables.emplace(v.variable_name, &v);
+    }
+  };
+
+  std::string render(abi_function_description const &f) {
+    std::ostringstream out;
+    Corpus::functionToJson(f, out);
+    return out.str();
+  }
+
+  // Describe how a single parameter (or return value) changed
+  void compare(parameter const &a, parameter const &b, std::string const &what,
+               std::vector<std::string> &reasons) {
+    auto check = [&](char const *field, std::string const &x, std::string const &y) {
+      if (x != y) reasons.push_back(what + " " + field + ": " + x + " -> " + y);
+    };
+    check("type", a.type_name(), b.type_name());
+    check("class", a.class_name(), b.class_name());
+    check("location", a.location(), b.location());
+    check("direction", a.direction(), b.direction());
+    check("size", std::to_string(a.size_in_bytes()), std::to_string(b.size_in_bytes()));
+  }
+
+  std::vector<std::string> compare(abi_function_description const &a,
+                                   abi_function_description const &b) {
+    std::vector<std::string> reasons;
+    if (a.parameters.size() != b.parameters.size()) {
+      reasons.push_back("parameter count: " + std::to_string(a.parameters.size()) + " -> "
+                        + std::to_string(b.parameters.size()));
+    }
+    auto const n = std::min(a.parameters.size(), b.parameters.size());
+    for (size_t i = 0; i < n; i++) {
+      auto what = "parameter " + std::to_string(i);
+      if (!a.parameters[i].name().empty()) what += " (" + a.parameters[i].name() + ")";
+      compare(a.parameters[i], b.parameters[i], what, reasons);
+    }
+    compare(a.return_value, b.return_value, "return", reasons);
+
+    // Nothing visible at the top level changed, so it must be nested (e.g., struct fields)
+    if (reasons.empty() && render(a) != render(b)) {
+      reasons.push_back("layout of an aggregate type changed");
+    }
+    return reasons;
+  }
+
+  std::vector<std::string> compare(abi_variable_description const &a,
+                                   abi_variable_description const &b) {
+    std::vector<std::string> reasons;
+    if (a.variable_type != b.variable_type) {
+      reasons.push_back("type: " + a.variable_type + " -> " + b.variable_type);
+    }
+    if (a.variable_size != b.variable_size) {
+      reasons.push_back("size: " + std::to_string(a.variable_size) + " -> "
+                        + std::to_string(b.variable_size));
+    }
+    return reasons;
+  }
+
+  void write_names(std::ostream &out, std::vector<std::string> const &names) {
+    out << "[";
+    for (auto const &n : names) {
+      out << (&n == &names.front() ? "\n   " : ",\n   ");
+      json::write_string(out, n);
+    }
+    out << (names.empty() ? "]" : "\n ]");
+  }
+}  // namespace
+
+CorpusDiff smeagle::diff(Corpus const &older, Corpus const &newer) {
+  CorpusDiff result;
+  symbol_index const before(older), after(newer);
+
+  for (auto const &[name, f] : before.functions) {
+    auto found = after.functions.find(name);
+    if (found == after.functions.end()) {
+      result.removed.push_back(name);
+    } else if (auto reasons = compare(*f, *found->second); !reasons.empty()) {
+      result.changed.push_back({name, std::move(reasons)});
+    }
+  }
+  for (auto const &[name, v] : before.variables) {
+    auto found = after.variables.find(name);
+    if (found == after.variables.end()) {
+      result.removed.push_back(name);
+    } else if (auto reasons = compare(*v, *found->second); !reasons.empty()) {
+      result.changed.push_back({name, std::move(reasons)});
+    }
+  }
+  for (auto const &[name, f] : after.functions) {
+    if (before.functions.count(name) == 0) result.added.push_back(name);
+  }
+  for (auto const &[name, v] : after.variables) {
+    if (before.variables.count(name) == 0) result.added.push_back(name);
+  }
+
+  // Hash order is not stable, so sort for reproducible output
+  std::sort(result.added.begin(), result.added.end());
+  std::sort(result.removed.begin(), result.removed.end());
+  std::sort(result.changed.begin(), result.changed.end(),
+            [](symbol_change const &a, symbol_change const &b) { return a.name < b.name; });
+  return result;
+}
+
+void CorpusDiff::toJson(std::ostream &out) const {
+  out << "{\n \"added\": ";
+  write_names(out, added);
+  out << ",\n \"removed\": ";
+  write_names(out, removed);
+  out << ",\n \"changed\": [";
+  for (auto const &c : changed) {
+    out << (&c == &changed.front() ? "\n" : ",\n") << "   {\"name\": ";
+    json::write_string(out, c.name);
+    out << ", \"reasons\": [";
+    for (auto const &r : c.reasons) {
+      if (&r != &c.reasons.front()) out << ", ";
+      json::write_string(out, r);
+    }
+    out << "]}";
+  }
+  out << (changed.empty() ? "]" : "\n ]") << "\n}" << std::endl;
+}
@@ -0,0 +1,569 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/dwarf.h"
+
+#include <elf.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include "hasher.hpp"
+
+using namespace smeagle;
+
+namespace {
+  // DWARF constants, which <elf.h> does not have
+  constexpr std::uint64_t DW_AT_name = 0x03;
+  constexpr std::uint64_t DW_AT_comp_dir = 0x1b;
+  constexpr std::uint64_t DW_AT_str_offsets_base = 0x72;
+  constexpr std::uint64_t DW_AT_dwo_name = 0x76;
+  constexpr std::uint64_t DW_AT_GNU_dwo_name = 0x2130;
+
+  constexpr std::uint8_t DW_UT_compile = 0x01;
+  constexpr std::uint8_t DW_UT_type = 0x02;
+  constexpr std::uint8_t DW_UT_partial = 0x03;
+  constexpr std::uint8_t DW_UT_skeleton = 0x04;
+  constexpr std::uint8_t DW_UT_split_compile = 0x05;
+  constexpr std::uint8_t DW_UT_split_type = 0x06;
+
+  constexpr std::uint8_t DW_OP_addr = 0x03;
+
+  enum form : std::uint64_t {
+    DW_FORM_addr = 0x01,
+    DW_FORM_block2 = 0x03,
+    DW_FORM_block4 = 0x04,
+    DW_FORM_data2 = 0x05,
+    DW_FORM_data4 = 0x06,
+    DW_FORM_data8 = 0x07,
+    DW_FORM_string = 0x08,
+    DW_FORM_block = 0x09,
+    DW_FORM_block1 = 0x0a,
+    DW_FORM_data1 = 0x0b,
+    DW_FORM_flag = 0x0c,
+    DW_FORM_sdata = 0x0d,
+    DW_FORM_strp = 0x0e,
+    DW_FORM_udata = 0x0f,
+    DW_FORM_ref_addr = 0x10,
+    DW_FORM_ref1 = 0x11,
+    DW_FORM_ref2 = 0x12,
+    DW_FORM_ref4 = 0x13,
+    DW_FORM_ref8 = 0x14,
+    DW_FORM_ref_udata = 0x15,
+    DW_FORM_indirect = 0x16,
+    DW_FORM_sec_offset = 0x17,
+    DW_FORM_exprloc = 0x18,
+    DW_FORM_flag_present = 0x19,
+    DW_FORM_strx = 0x1a,
+    DW_FORM_addrx = 0x1b,
+    DW_FORM_ref_sup4 = 0x1c,
+    DW_FORM_strp_sup = 0x1d,
+    DW_FORM_data16 = 0x1e,
+    DW_FORM_line_strp = 0x1f,
+    DW_FORM_ref_sig8 = 0x20,
+    DW_FORM_implicit_const = 0x21,
+    DW_FORM_loclistx = 0x22,
+    DW_FORM_rnglistx = 0x23,
+    DW_FORM_ref_sup8 = 0x24,
+    DW_FORM_strx1 = 0x25,
+    DW_FORM_strx2 = 0x26,
+    DW_FORM_strx3 = 0x27,
+    DW_FORM_strx4 = 0x28,
+    DW_FORM_addrx1 = 0x29,
+    DW_FORM_addrx2 = 0x2a,
+    DW_FORM_addrx3 = 0x2b,
+    DW_FORM_addrx4 = 0x2c,
+    DW_FORM_GNU_addr_index = 0x1f01,
+    DW_FORM_GNU_str_index = 0x1f02,
+    DW_FORM_GNU_ref_alt = 0x1f20,
+    DW_FORM_GNU_strp_alt = 0x1f21,
+  };
+
+  // Reads little endian values from a section, throwing when it runs out
+  class cursor {
+    std::string_view data;
+    size_t pos;
+
+  public:
+    cursor(std::string_view _data, size_t _pos) : data(_data), pos(_pos) {}
+
+    size_t offset() const { return pos; }
+    bool done() const { return pos >= data.size(); }
+
+    void skip(std::uint64_t n) {
+      if (n > data.size() - pos) throw std::runtime_error{"Truncated DWARF"};
+      pos += n;
+    }
+
+    std::uint64_t fixed(size_t n) {
+      if (n > data.size() - pos) throw std::runtime_error{"Truncated DWARF"};
+      std::uint64_t value = 0;
+      for (size_t i = 0; i < n; i++) {
+        value |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+      }
+      pos += n;
+      return value;
+    }
+
+    std::uint64_t uleb() {
+      std::uint64_t value = 0;
+      for (unsigned shift = 0;; shift += 7) {
+        auto const byte = fixed(1);
+        if (shift < 64) value |= (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+      }
+    }
+
+    std::int64_t sleb() {
+      std::int64_t value = 0;
+      unsigned shift = 0;
+      std::uint64_t byte;
+      do {
+        byte = fixed(1);
+        if (shift < 64) value |= static_cast<std::int64_t>(byte & 0x7f) << shift;
+        shift += 7;
+      } while (byte & 0x80);
+      if (shift < 64 && (byte & 0x40)) value |= -(std::int64_t{1} << shift);
+      return value;
+    }
+
+    std::string_view bytes(std::uint64_t n) {
+      if (n > data.size() - pos) throw std::runtime_error{"Truncated DWARF"};
+      auto const s = data.substr(pos, n);
+      pos += n;
+      return s;
+    }
+
+    std::string_view cstring() {
+      auto const end = data.find('\0', pos);
+      if (end == std::string_view::npos) throw std::runtime_error{"Truncated DWARF"};
+      auto const s = data.substr(pos, end - pos);
+      pos = end + 1;
+      return s;
+    }
+  };
+
+  std::string_view cstring_at(std::string_view section, std::uint64_t offset) {
+    if (offset >= section.size()) return {};
+    return cursor(section, offset).cstring();
+  }
+
+  // The sections units are read from (those of a .dwo for split units)
+  struct sections {
+    std::string_view info, abbrevs, strings, line_strings, str_offsets;
+  };
+
+  struct attribute {
+    std::uint64_t name, form;
+    std::int64_t implicit_const;
+  };
+
+  struct abbreviation {
+    std::uint64_t tag = 0;
+    bool children = false;
+    std::vector<attribute> attributes;
+  };
+
+  using abbreviation_table = std::unordered_map<std::uint64_t, abbreviation>;
+
+  // Read the abbreviation table at offset, up to its end
+  abbreviation_table read_abbreviations(std::string_view abbrevs, std::uint64_t offset) {
+    abbreviation_table table;
+    if (offset >= abbrevs.size()) return table;
+    cursor in(abbrevs, offset);
+    while (!in.done()) {
+      auto const code = in.uleb();
+      if (code == 0) break;
+      abbreviation current;
+      current.tag = in.uleb();
+      current.children = in.fixed(1) != 0;
+      while (true) {
+        auto const name = in.uleb();
+        auto const form = in.uleb();
+        if (name == 0 && form == 0) break;
+        std::int64_t value = form == DW_FORM_implicit_const ? in.sleb() : 0;
+        current.attributes.push_back({name, form, value});
+      }
+      table.emplace(code, std::move(current));
+    }
+    return table;
+  }
+
+  struct unit_header {
+    std::uint16_t version;
+    std::uint8_t unit_type;
+    std::uint8_t address_size;
+    std::uint8_t offset_size;
+    std::uint64_t abbrev_offset;
+    std::uint64_t dwo_id;
+  };
+
+  // Read the header of the unit at the cursor, returning where the unit ends
+  // (or nothing if its length runs past the section)
+  std::optional<size_t> read_header(cursor &in, std::string_view info, unit_header &header) {
+    header = {};
+    header.offset_size = 4;
+    std::uint64_t length = in.fixed(4);
+    if (length == 0xffffffff) {
+      header.offset_size = 8;
+      length = in.fixed(8);
+    }
+    if (length > info.size() - in.offset()) return std::nullopt;
+    auto const end = in.offset() + length;
+
+    header.version = static_cast<std::uint16_t>(in.fixed(2));
+    if (header.version >= 5) {
+      header.unit_type = static_cast<std::uint8_t>(in.fixed(1));
+      header.address_size = static_cast<std::uint8_t>(in.fixed(1));
+      header.abbrev_offset = in.fixed(header.offset_size);
+      if (header.unit_type == DW_UT_skeleton || header.unit_type == DW_UT_split_compile) {
+        header.dwo_id = in.fixed(8);
+      } else if (header.unit_type == DW_UT_type || header.unit_type == DW_UT_split_type) {
+        in.skip(8 + header.offset_size);  // type signature and offset
+      }
+    } else {
+      header.unit_type = DW_UT_compile;
+      header.abbrev_offset = in.fixed(header.offset_size);
+      header.address_size = static_cast<std::uint8_t>(in.fixed(1));
+    }
+    return end;
+  }
+
+  // Where every unit of a .debug_info starts, to resolve DW_FORM_ref_addr
+  std::vector<std::uint64_t> unit_starts(std::string_view info) {
+    std::vector<std::uint64_t> starts;
+    cursor in(info, 0);
+    unit_header header;
+    while (!in.done()) {
+      starts.push_back(in.offset());
+      auto const end = read_header(in, info, header);
+      if (!end) break;
+      in = cursor(info, *end);
+    }
+    return starts;
+  }
+
+  // Read the value of an attribute: numbers are returned, strings, blocks
+  // and expressions are left in bytes
+  std::uint64_t read_form(cursor &in, std::uint64_t form, unit_header const &header,
+                          std::string_view &bytes) {
+    switch (form) {
+      case DW_FORM_addr:
+        return in.fixed(header.address_size);
+      case DW_FORM_data1:
+      case DW_FORM_ref1:
+      case DW_FORM_flag:
+      case DW_FORM_strx1:
+      case DW_FORM_addrx1:
+        return in.fixed(1);
+      case DW_FORM_data2:
+      case DW_FORM_ref2:
+      case DW_FORM_strx2:
+      case DW_FORM_addrx2:
+        return in.fixed(2);
+      case DW_FORM_strx3:
+      case DW_FORM_addrx3:
+        return in.fixed(3);
+      case DW_FORM_data4:
+      case DW_FORM_ref4:
+      case DW_FORM_ref_sup4:
+      case DW_FORM_strx4:
+      case DW_FORM_addrx4:
+        return in.fixed(4);
+      case DW_FORM_data8:
+      case DW_FORM_ref8:
+      case DW_FORM_ref_sig8:
+      case DW_FORM_ref_sup8:
+        return in.fixed(8);
+      case DW_FORM_data16:
+        bytes = in.bytes(16);
+        return 0;
+      case DW_FORM_string:
+        bytes = in.cstring();
+        return 0;
+      case DW_FORM_block1:
+        bytes = in.bytes(in.fixed(1));
+        return 0;
+      case DW_FORM_block2:
+        bytes = in.bytes(in.fixed(2));
+        return 0;
+      case DW_FORM_block4:
+        bytes = in.bytes(in.fixed(4));
+        return 0;
+      case DW_FORM_block:
+      case DW_FORM_exprloc:
+        bytes = in.bytes(in.uleb());
+        return 0;
+      case DW_FORM_sdata:
+        return static_cast<std::uint64_t>(in.sleb());
+      case DW_FORM_udata:
+      case DW_FORM_ref_udata:
+      case DW_FORM_strx:
+      case DW_FORM_addrx:
+      case DW_FORM_loclistx:
+      case DW_FORM_rnglistx:
+      case DW_FORM_GNU_addr_index:
+      case DW_FORM_GNU_str_index:
+        return in.uleb();
+      case DW_FORM_strp:
+      case DW_FORM_line_strp:
+      case DW_FORM_sec_offset:
+      case DW_FORM_strp_sup:
+      case DW_FORM_GNU_ref_alt:
+      case DW_FORM_GNU_strp_alt:
+        return in.fixed(header.offset_size);
+      case DW_FORM_ref_addr:
+        return in.fixed(header.version <= 2 ? header.address_size : header.offset_size);
+      case DW_FORM_flag_present:
+      case DW_FORM_implicit_const:
+        return 0;
+      case DW_FORM_indirect:
+        return read_form(in, in.uleb(), header, bytes);
+      default:
+        throw std::runtime_error{"Unknown DWARF form " + std::to_string(form)};
+    }
+  }
+
+  bool is_strx(std::uint64_t form) {
+    return form == DW_FORM_strx || form == DW_FORM_strx1 || form == DW_FORM_strx2
+           || form == DW_FORM_strx3 || form == DW_FORM_strx4 || form == DW_FORM_GNU_str_index;
+  }
+
+  bool is_address(std::uint64_t form) {
+    return form == DW_FORM_addr || form == DW_FORM_addrx || form == DW_FORM_addrx1
+           || form == DW_FORM_addrx2 || form == DW_FORM_addrx3 || form == DW_FORM_addrx4
+           || form == DW_FORM_GNU_addr_index;
+  }
+
+  // Reads the DIEs of one unit, with its strings resolved
+  struct unit_reader {
+    sections const &in;
+    unit_header const &header;
+    abbreviation_table const &abbrevs;
+    std::vector<std::uint64_t> const &starts;
+    std::optional<std::uint64_t> str_offsets_base;
+
+    std::string_view string(std::uint64_t form, std::uint64_t value,
+                            std::string_view inline_string) const {
+      if (form == DW_FORM_string) return inline_string;
+      if (form == DW_FORM_strp) return cstring_at(in.strings, value);
+      if (form == DW_FORM_line_strp) return cstring_at(in.line_strings, value);
+      if (is_strx(form) && str_offsets_base) {
+        auto const entry = *str_offsets_base + value * header.offset_size;
+        if (entry < in.str_offsets.size()
+            && header.offset_size <= in.str_offsets.size() - entry) {
+          return cstring_at(in.strings, cursor(in.str_offsets, entry).fixed(header.offset_size));
+        }
+      }
+      return {};
+    }
+
+    // Hash what the DIEs say rather than how they are laid out: strings by
+    // their contents, and neither addresses nor offsets into other sections,
+    // which move when an earlier unit or function changes
+    void hash(cursor &die, size_t end, hasher &hash) const {
+      while (die.offset() < end) {
+        auto const code = die.uleb();
+        if (code == 0) {
+          hash.add_size(0);  // the end of a list of children
+          continue;
+        }
+        auto const found = abbrevs.find(code);
+        if (found == abbrevs.end()) throw std::runtime_error{"Unknown DWARF abbreviation"};
+        hash.add_size(found->second.tag);
+        hash.add_size(found->second.children);
+        for (auto const &a : found->second.attributes) {
+          auto form = a.form;
+          if (form == DW_FORM_indirect) form = die.uleb();
+          std::string_view bytes;
+          auto const value = read_form(die, form, header, bytes);
+          hash.add_size(a.name);
+          if (form == DW_FORM_string || form == DW_FORM_strp || form == DW_FORM_line_strp
+              || is_strx(form)) {
+            hash.add(string(form, value, bytes));
+          } else if (is_address(form) || form == DW_FORM_sec_offset) {
+            hash.add_size(0);
+          } else if (form == DW_FORM_ref_addr) {
+            // A DIE of another unit, by that unit and where it is in it
+            auto const unit = std::upper_bound(starts.begin(), starts.end(), value);
+            auto const index = static_cast<std::uint64_t>(unit - starts.begin());
+            hash.add_size(index);
+            hash.add_size(index ? value - *(unit - 1) : value);
+          } else if (form == DW_FORM_exprloc || form == DW_FORM_block1 || form == DW_FORM_block2
+                     || form == DW_FORM_block4 || form == DW_FORM_block) {
+            // The location of a global variable is its address
+            auto const address = bytes.size() == 1u + header.address_size
+                                 && static_cast<std::uint8_t>(bytes[0]) == DW_OP_addr;
+            hash.add(address ? bytes.substr(0, 1) : bytes);
+          } else if (form == DW_FORM_implicit_const) {
+            hash.add_size(static_cast<std::uint64_t>(a.implicit_const));
+          } else if (form == DW_FORM_data16) {
+            hash.add(bytes);
+          } else {
+            hash.add_size(value);
+          }
+        }
+      }
+    }
+  };
+
+  // The attributes of a unit DIE that say what it is and where its strings are
+  struct unit_die {
+    std::string_view name, comp_dir, dwo_name;
+    std::optional<std::uint64_t> str_offsets_base;
+  };
+
+  unit_die read_unit_die(cursor die, sections const &in, unit_header const &header,
+                         abbreviation_table const &abbrevs,
+                         std::optional<std::uint64_t> str_offsets_base = std::nullopt) {
+    unit_die result;
+    result.str_offsets_base = str_offsets_base;
+    auto const found = abbrevs.find(die.uleb());
+    if (found == abbrevs.end()) throw std::runtime_error{"Unknown DWARF abbreviation"};
+
+    // Indexed strings can come before the base, so they are resolved after
+    struct string_value {
+      std::uint64_t name, form, value;
+      std::string_view inline_string;
+    };
+    std::vector<string_value> strings;
+    for (auto const &a : found->second.attributes) {
+      auto form = a.form;
+      if (form == DW_FORM_indirect) form = die.uleb();
+      std::string_view bytes;
+      auto const value = read_form(die, form, header, bytes);
+      if (a.name == DW_AT_str_offsets_base) {
+        result.str_offsets_base = value;
+      } else if (a.name == DW_AT_name || a.name == DW_AT_comp_dir || a.name == DW_AT_dwo_name
+                 || a.name == DW_AT_GNU_dwo_name) {
+        strings.push_back({a.name, form, value, bytes});
+      }
+    }
+
+    std::vector<std::uint64_t> const no_starts;
+    unit_reader const reader{in, header, abbrevs, no_starts, result.str_offsets_base};
+    for (auto const &s : strings) {
+      auto const value = reader.string(s.form, s.value, s.inline_string);
+      if (s.name == DW_AT_name) {
+        result.name = value;
+      } else if (s.name == DW_AT_comp_dir) {
+        result.comp_dir = value;
+      } else {
+        result.dwo_name = value;
+      }
+    }
+    return result;
+  }
+
+  // Hash the DIEs of every unit of a split DWARF file, false if it cannot be
+  // read, and get the name of its compilation unit (which skeletons leave out)
+  bool hash_split_units(std::string const &path, hasher &hash, std::string &name) {
+    std::optional<elf::File> dwo;
+    try {
+      dwo.emplace(path);
+    } catch (std::runtime_error const &) {
+      return false;
+    }
+    auto contents = [&dwo](char const *name) -> std::string_view {
+      auto const *s = dwo->find_section(name);
+      return s && !(s->flags & SHF_COMPRESSED) ? dwo->contents(*s) : std::string_view{};
+    };
+    sections const in{contents(".debug_info.dwo"), contents(".debug_abbrev.dwo"),
+                      contents(".debug_str.dwo"), {}, contents(".debug_str_offsets.dwo")};
+    if (in.info.empty()) return false;
+
+    auto const starts = unit_starts(in.info);
+    cursor unit(in.info, 0);
+    unit_header header;
+    while (!unit.done()) {
+      auto const end = read_header(unit, in.info, header);
+      if (!end) return false;
+      auto const abbrevs = read_abbreviations(in.abbrevs, header.abbrev_offset);
+      // A .dwo has one contribution to its string offsets, after the DWARF 5 header
+      std::uint64_t const base = header.version >= 5 ? (header.offset_size == 8 ? 16 : 8) : 0;
+      if (header.unit_type == DW_UT_split_compile || header.version < 5) {
+        name = read_unit_die(unit, in, header, abbrevs, base).name;
+      }
+      unit_reader const reader{in, header, abbrevs, starts, base};
+      reader.hash(unit, *end, hash);
+      unit = cursor(in.info, *end);
+    }
+    return true;
+  }
+
+  // Where the .dwo of a skeleton unit is: under its compilation directory, or next to the object
+  std::string find_dwo(unit_die const &die, std::string const &object) {
+    namespace fs = std::filesystem;
+    fs::path const name(std::string(die.dwo_name));
+    std::error_code ec;
+    auto const in_comp_dir = name.is_absolute() ? name : fs::path(std::string(die.comp_dir)) / name;
+    if (fs::exists(in_comp_dir, ec)) return in_comp_dir.string();
+    auto const beside = fs::path(object).parent_path() / name.filename();
+    if (fs::exists(beside, ec)) return beside.string();
+    return {};
+  }
+}  // namespace
+
+std::vector<dwarf::unit> dwarf::units(elf::File const &file) {
+  auto contents = [&file](char const *name) -> std::string_view {
+    auto const *s = file.find_section(name);
+    return s && !(s->flags & SHF_COMPRESSED) ? file.contents(*s) : std::string_view{};
+  };
+  sections const in{contents(".debug_info"), contents(".debug_abbrev"), contents(".debug_str"),
+                    contents(".debug_line_str"), contents(".debug_str_offsets")};
+
+  std::vector<unit> units;
+  auto const starts = unit_starts(in.info);
+  std::map<std::uint64_t, abbreviation_table> tables;
+  cursor next(in.info, 0);
+  while (!next.done()) {
+    auto const start = next.offset();
+    unit_header header;
+    auto const end = read_header(next, in.info, header);
+    if (!end) break;
+
+    if (header.version >= 2 && header.version <= 5
+        && (header.unit_type == DW_UT_compile || header.unit_type == DW_UT_partial
+            || header.unit_type == DW_UT_skeleton)) {
+      // A unit that cannot be read is left out, and is then described every time
+      try {
+        auto table = tables.find(header.abbrev_offset);
+        if (table == tables.end()) {
+          table = tables.emplace(header.abbrev_offset,
+                                 read_abbreviations(in.abbrevs, header.abbrev_offset))
+                      .first;
+        }
+        auto const die = read_unit_die(next, in, header, table->second);
+
+        hasher hash;
+        unit_reader const reader{in, header, table->second, starts, die.str_offsets_base};
+        cursor dies = next;
+        reader.hash(dies, *end, hash);
+
+        // The types of a split unit are in its .dwo, whose id changes with it
+        std::string name(die.name);
+        if (!die.dwo_name.empty() || header.unit_type == DW_UT_skeleton) {
+          hash.add_size(header.dwo_id);
+          auto const dwo = die.dwo_name.empty() ? std::string() : find_dwo(die, file.name());
+          std::string split_name;
+          if (dwo.empty() || !hash_split_units(dwo, hash, split_name)) {
+            hash.add("no dwo");
+          }
+          if (name.empty()) name = std::move(split_name);
+        }
+        units.push_back({std::move(name), start, hash.hex()});
+      } catch (std::runtime_error const &) {
+        // Not a unit we can read
+      }
+    }
+    next = cursor(in.info, *end);
+  }
+  return units;
+}
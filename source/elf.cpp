@@ -0,0 +1,403 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/elf.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+
+#include "mapped_file.hpp"
+
+using namespace smeagle;
+
+namespace {
+  bool host_is_little_endian() {
+    std::uint16_t const one = 1;
+    return *reinterpret_cast<unsigned char const *>(&one) == 1;
+  }
+
+  // The 32 and 64 bit layouts only differ in their types
+  struct elf32 {
+    using Ehdr = Elf32_Ehdr;
+    using Shdr = Elf32_Shdr;
+    using Phdr = Elf32_Phdr;
+    using Dyn = Elf32_Dyn;
+    using Nhdr = Elf32_Nhdr;
+  };
+  struct elf64 {
+    using Ehdr = Elf64_Ehdr;
+    using Shdr = Elf64_Shdr;
+    using Phdr = Elf64_Phdr;
+    using Dyn = Elf64_Dyn;
+    using Nhdr = Elf64_Nhdr;
+  };
+
+  template <typename T> T read_struct(char const *base, size_t length, std::uint64_t offset) {
+    if (offset > length || length - offset < sizeof(T)) {
+      throw std::runtime_error{"Truncated ELF object"};
+    }
+    T value;
+    std::memcpy(&value, base + offset, sizeof(T));
+    return value;
+  }
+
+  std::string to_hex(unsigned char const *bytes, size_t n) {
+    static char const digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(n * 2);
+    for (size_t i = 0; i < n; i++) {
+      hex += digits[bytes[i] >> 4];
+      hex += digits[bytes[i] & 0xf];
+    }
+    return hex;
+  }
+
+  // Find the GNU build-id in a block of notes
+  std::string find_build_id(std::string_view notes) {
+    size_t pos = 0;
+    while (notes.size() - pos >= sizeof(Elf64_Nhdr)) {
+      // The note header has the same layout in 32 and 64 bit objects
+      Elf64_Nhdr note;
+      std::memcpy(&note, notes.data() + pos, sizeof note);
+      pos += sizeof note;
+      auto const name_size = (static_cast<size_t>(note.n_namesz) + 3) & ~size_t{3};
+      auto const desc_size = (static_cast<size_t>(note.n_descsz) + 3) & ~size_t{3};
+      if (notes.size() - pos < name_size || notes.size() - pos - name_size < note.n_descsz) {
+        break;
+      }
+      auto const name = notes.substr(pos, note.n_namesz);
+      pos += name_size;
+      if (note.n_type == NT_GNU_BUILD_ID && name == std::string_view("GNU\0", 4)) {
+        return to_hex(reinterpret_cast<unsigned char const *>(notes.data() + pos), note.n_descsz);
+      }
+      pos += desc_size;
+    }
+    return {};
+  }
+}  // namespace
+
+bool elf::has_magic(void const *data, size_t size) {
+  return size >= SELFMAG && std::memcmp(data, ELFMAG, SELFMAG) == 0;
+}
+
+bool elf::has_magic(std::string const &path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  char magic[SELFMAG];
+  auto const n = read(fd, magic, sizeof magic);
+  close(fd);
+  return n == SELFMAG && has_magic(magic, SELFMAG);
+}
+
+elf::File::File(std::string _path) : path(std::move(_path)) {
+  std::tie(base, length) = map_file(path);
+  mapped = true;
+
+  try {
+    load();
+  } catch (...) {
+    unmap_file(base, length);
+    throw;
+  }
+}
+
+elf::File::File(void const *data, size_t size, std::string name)
+    : path(std::move(name)), base(static_cast<char const *>(data)), length(size) {
+  load();
+}
+
+elf::File::~File() {
+  if (mapped) {
+    unmap_file(base, length);
+  }
+}
+
+void elf::File::load() {
+  if (!has_magic(base, length) || length < EI_NIDENT) {
+    throw std::runtime_error{"'" + path + "' is not an ELF object"};
+  }
+  auto const data = static_cast<unsigned char>(base[EI_DATA]);
+  if ((data == ELFDATA2LSB) != host_is_little_endian()) {
+    throw std::runtime_error{"'" + path + "' does not have the byte order of this machine"};
+  }
+
+  auto parse = [this](auto layout) {
+    using L = decltype(layout);
+    auto const ehdr = read_struct<typename L::Ehdr>(base, length, 0);
+    elf_type = ehdr.e_type;
+    elf_machine = ehdr.e_machine;
+
+    for (size_t i = 0; i < ehdr.e_phnum; i++) {
+      auto const phdr = read_struct<typename L::Phdr>(base, length, ehdr.e_phoff + i * ehdr.e_phentsize);
+      segments.push_back({phdr.p_type, phdr.p_offset, phdr.p_vaddr, phdr.p_filesz});
+    }
+
+    std::vector<typename L::Shdr> headers;
+    for (size_t i = 0; ehdr.e_shoff != 0 && i < ehdr.e_shnum; i++) {
+      headers.push_back(
+          read_struct<typename L::Shdr>(base, length, ehdr.e_shoff + i * ehdr.e_shentsize));
+    }
+
+    // Section names live in the section header string table
+    std::string_view names;
+    if (ehdr.e_shstrndx < headers.size()) {
+      auto const &strtab = headers[ehdr.e_shstrndx];
+      if (strtab.sh_offset <= length && strtab.sh_size <= length - strtab.sh_offset) {
+        names = std::string_view(base + strtab.sh_offset, strtab.sh_size);
+      }
+    }
+    for (auto const &h : headers) {
+      auto name = std::string(string_at(names, h.sh_name));
+      all_sections.push_back(
+          {std::move(name), h.sh_type, h.sh_flags, h.sh_addr, h.sh_offset, h.sh_size, h.sh_link,
+           h.sh_entsize});
+    }
+  };
+
+  if (base[EI_CLASS] == ELFCLASS64) {
+    is64 = true;
+    parse(elf64{});
+  } else if (base[EI_CLASS] == ELFCLASS32) {
+    parse(elf32{});
+  } else {
+    throw std::runtime_error{"'" + path + "' has an unknown ELF class"};
+  }
+}
+
+bool elf::File::is_shared_library() const {
+  if (elf_type != ET_DYN) return false;
+
+  // Separate debug files are ET_DYN too, with their code left out
+  auto has_code = false, has_code_bits = false;
+  for (auto const &s : all_sections) {
+    if ((s.flags & SHF_ALLOC) && (s.flags & SHF_EXECINSTR)) {
+      has_code = true;
+      has_code_bits = has_code_bits || s.type != SHT_NOBITS;
+    }
+  }
+  if (has_code && !has_code_bits) return false;
+
+  auto const slash = path.rfind('/');
+  auto const filename = slash == std::string::npos ? path : path.substr(slash + 1);
+  return filename.find(".so") != std::string::npos || !soname().empty();
+}
+
+elf::section const *elf::File::find_section(std::string_view name) const {
+  for (auto const &s : all_sections) {
+    if (s.name == name) return &s;
+  }
+  return nullptr;
+}
+
+std::string_view elf::File::contents(section const &s) const {
+  if (s.type == SHT_NOBITS || s.offset > length || s.size > length - s.offset) {
+    return {};
+  }
+  return {base + s.offset, s.size};
+}
+
+std::uint64_t elf::File::to_offset(std::uint64_t vaddr) const {
+  for (auto const &seg : segments) {
+    if (seg.type == PT_LOAD && vaddr >= seg.vaddr && vaddr - seg.vaddr < seg.filesz) {
+      return seg.offset + (vaddr - seg.vaddr);
+    }
+  }
+  return length;
+}
+
+std::string elf::File::build_id() const {
+  for (auto const &s : all_sections) {
+    if (s.type == SHT_NOTE) {
+      if (auto id = find_build_id(contents(s)); !id.empty()) return id;
+    }
+  }
+
+  // Objects without section headers still have their notes in segments
+  for (auto const &seg : segments) {
+    if (seg.type == PT_NOTE && seg.offset <= length && seg.filesz <= length - seg.offset) {
+      if (auto id = find_build_id({base + seg.offset, seg.filesz}); !id.empty()) return id;
+    }
+  }
+  return {};
+}
+
+bool elf::File::has_dwarf() const {
+  auto const *info = find_section(".debug_info");
+  return info && info->type != SHT_NOBITS && info->size > 0;
+}
+
+std::string elf::File::debuglink(std::uint32_t *crc) const {
+  auto const *link = find_section(".gnu_debuglink");
+  if (!link) return {};
+
+  // A file name, padded to 4 bytes, then the CRC
+  auto const data = contents(*link);
+  auto const end = data.find('\0');
+  if (end == std::string_view::npos || end == 0) return {};
+  auto const crc_offset = (end + 4) & ~size_t{3};
+  if (data.size() < crc_offset + 4) return {};
+  if (crc) std::memcpy(crc, data.data() + crc_offset, 4);
+  return std::string(data.substr(0, end));
+}
+
+std::uint64_t elf::File::parse_cost() const {
+  // About what describing one symbol costs, in bytes of DWARF
+  constexpr std::uint64_t per_symbol = 256;
+
+  std::uint64_t cost = 0;
+  if (auto const *info = find_section(".debug_info")) {
+    cost += info->size;
+  }
+
+  // Libraries are described by their dynamic symbols, relocatable objects by all of them
+  section const *symbols = nullptr;
+  for (auto const &s : all_sections) {
+    if (s.type == SHT_DYNSYM || (s.type == SHT_SYMTAB && !symbols)) {
+      symbols = &s;
+    }
+  }
+  if (symbols && symbols->entsize > 0) {
+    cost += symbols->size / symbols->entsize * per_symbol;
+  }
+  return cost;
+}
+
+namespace {
+  // Collect the string values of one dynamic tag
+  template <typename Dyn>
+  std::vector<std::string> dynamic_strings(std::string_view dynamic, std::string_view strtab,
+                                           std::int64_t tag) {
+    std::vector<std::string> values;
+    for (size_t pos = 0; dynamic.size() - pos >= sizeof(Dyn); pos += sizeof(Dyn)) {
+      Dyn d;
+      std::memcpy(&d, dynamic.data() + pos, sizeof d);
+      if (d.d_tag == DT_NULL) break;
+      if (d.d_tag == tag && d.d_un.d_val < strtab.size()) {
+        values.emplace_back(elf::string_at(strtab, d.d_un.d_val));
+      }
+    }
+    return values;
+  }
+}  // namespace
+
+std::vector<std::string> elf::File::dynamic(std::int64_t tag) const {
+  // Prefer the section headers, which also tell us where the strings are
+  for (auto const &s : all_sections) {
+    if (s.type == SHT_DYNAMIC && s.link < all_sections.size()) {
+      auto const entries = contents(s);
+      auto const strtab = contents(all_sections[s.link]);
+      return is64 ? dynamic_strings<Elf64_Dyn>(entries, strtab, tag)
+                  : dynamic_strings<Elf32_Dyn>(entries, strtab, tag);
+    }
+  }
+
+  // Otherwise, find the dynamic segment and its DT_STRTAB
+  for (auto const &seg : segments) {
+    if (seg.type != PT_DYNAMIC || seg.offset > length || seg.filesz > length - seg.offset) {
+      continue;
+    }
+    std::string_view const entries(base + seg.offset, seg.filesz);
+    auto strtab_offset = std::uint64_t{length};
+    auto find_strtab = [&](auto d) {
+      for (size_t pos = 0; entries.size() - pos >= sizeof d; pos += sizeof d) {
+        std::memcpy(&d, entries.data() + pos, sizeof d);
+        if (d.d_tag == DT_NULL) break;
+        if (d.d_tag == DT_STRTAB) strtab_offset = to_offset(d.d_un.d_ptr);
+      }
+    };
+    is64 ? find_strtab(Elf64_Dyn{}) : find_strtab(Elf32_Dyn{});
+    if (strtab_offset >= length) return {};
+    std::string_view const strtab(base + strtab_offset, length - strtab_offset);
+    return is64 ? dynamic_strings<Elf64_Dyn>(entries, strtab, tag)
+                : dynamic_strings<Elf32_Dyn>(entries, strtab, tag);
+  }
+  return {};
+}
+
+std::vector<std::string> elf::File::needed() const { return dynamic(DT_NEEDED); }
+
+std::string elf::File::soname() const {
+  auto values = dynamic(DT_SONAME);
+  return values.empty() ? std::string{} : values.front();
+}
+
+std::string elf::File::rpath() const {
+  auto values = dynamic(DT_RPATH);
+  return values.empty() ? std::string{} : values.front();
+}
+
+std::string elf::File::runpath() const {
+  auto values = dynamic(DT_RUNPATH);
+  return values.empty() ? std::string{} : values.front();
+}
+
+namespace {
+  // Is this the debug file of an object with this build-id and debug link CRC?
+  bool is_debug_file_of(std::string const &path, std::string const &object_path,
+                        std::string const &build_id, std::optional<std::uint32_t> crc) {
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec) || !elf::has_magic(path)
+        || std::filesystem::equivalent(path, object_path, ec)) {
+      return false;
+    }
+    try {
+      elf::File candidate(path);
+      if (!candidate.has_dwarf()) return false;
+      auto const candidate_id = candidate.build_id();
+      if (!build_id.empty() && !candidate_id.empty()) {
+        return candidate_id == build_id;
+      }
+      if (!crc) return false;
+      auto sum = crc32(0L, Z_NULL, 0);
+      auto const *bytes = reinterpret_cast<Bytef const *>(candidate.data());
+      for (size_t done = 0; done < candidate.size();) {
+        auto const n = static_cast<uInt>(std::min<size_t>(candidate.size() - done, 1u << 30));
+        sum = crc32(sum, bytes + done, n);
+        done += n;
+      }
+      return static_cast<std::uint32_t>(sum) == *crc;
+    } catch (std::runtime_error const &) {
+      return false;
+    }
+  }
+}  // namespace
+
+std::string elf::find_debug_file(File const &object, std::vector<std::string> const &debug_dirs) {
+  if (object.has_dwarf()) return {};
+  namespace fs = std::filesystem;
+  auto const build_id = object.build_id();
+
+  if (build_id.size() > 2) {
+    for (auto const &dir : debug_dirs) {
+      auto const path = (fs::path(dir) / ".build-id" / build_id.substr(0, 2)
+                         / (build_id.substr(2) + ".debug"))
+                            .string();
+      if (is_debug_file_of(path, object.name(), build_id, std::nullopt)) return path;
+    }
+  }
+
+  std::uint32_t crc = 0;
+  auto const link = object.debuglink(&crc);
+  if (link.empty()) return {};
+  std::error_code ec;
+  auto directory = fs::absolute(object.name(), ec).parent_path();
+  std::vector<fs::path> candidates{directory / link, directory / ".debug" / link};
+  for (auto const &dir : debug_dirs) {
+    candidates.push_back(fs::path(dir) / directory.relative_path() / link);
+  }
+  for (auto const &path : candidates) {
+    if (is_debug_file_of(path.string(), object.name(), build_id, crc)) return path.string();
+  }
+  return {};
+}
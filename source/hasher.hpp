@@ -0,0 +1,44 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace smeagle {
+
+  // Two 64 bit FNV-1a hashes with different bases, for a 128 bit result
+  struct hasher {
+    std::uint64_t a = 14695981039346656037ull;
+    std::uint64_t b = 0x84222325cbf29ce4ull;
+
+    void add(std::string_view bytes) {
+      for (unsigned char c : bytes) {
+        a = (a ^ c) * 1099511628211ull;
+        b = (b ^ c) * 1099511628211ull;
+      }
+      // Keep the boundaries, so moving bytes from one part to the next changes the hash
+      add_size(bytes.size());
+    }
+
+    void add_size(std::uint64_t n) {
+      for (int i = 0; i < 8; i++, n >>= 8) {
+        a = (a ^ (n & 0xff)) * 1099511628211ull;
+        b = (b ^ (n & 0xff)) * 1099511628211ull;
+      }
+    }
+
+    std::string hex() const {
+      char buffer[33];
+      std::snprintf(buffer, sizeof buffer, "%016llx%016llx", static_cast<unsigned long long>(a),
+                    static_cast<unsigned long long>(b));
+      return buffer;
+    }
+  };
+
+}  // namespace smeagle
@@ -0,0 +1,401 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace smeagle::json {
+
+  // Write a string escaped for use inside a json string literal
+  inline void write_escaped(std::ostream &out, std::string_view s) {
+    for (char c : s) {
+      switch (c) {
+        case '"':
+          out << "\\\"";
+          break;
+        case '\\':
+          out << "\\\\";
+          break;
+        case '\n':
+          out << "\\n";
+          break;
+        case '\t':
+          out << "\\t";
+          break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof buf, "\\u%04x", c);
+            out << buf;
+          } else {
+            out << c;
+          }
+      }
+    }
+  }
+
+  // Write a quoted and escaped json string
+  inline void write_string(std::ostream &out, std::string_view s) {
+    out << '"';
+    write_escaped(out, s);
+    out << '"';
+  }
+
+  // A parsed json document, just enough to read back what we write
+  struct value {
+    enum class kind { null, boolean, number, string, array, object };
+
+    kind type = kind::null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<value> array;
+    std::vector<std::pair<std::string, value>> object;  // in document order
+
+    // The member with this key, or null if there is none (or this is no object)
+    value const *find(std::string_view key) const {
+      for (auto const &[k, v] : object) {
+        if (k == key) return &v;
+      }
+      return nullptr;
+    }
+
+    // The member with this key, which must be there
+    value const &at(std::string_view key) const {
+      if (auto const *v = find(key)) return *v;
+      throw std::runtime_error{"Missing json member '" + std::string(key) + "'"};
+    }
+  };
+
+  namespace detail {
+    class reader {
+    protected:
+      std::string_view text;
+      size_t pos = 0;
+
+      // Objects and arrays are read recursively, so their nesting is limited
+      // to keep a hostile document from running out of stack
+      static constexpr size_t max_depth = 512;
+      size_t depth = 0;
+
+      struct nested {
+        reader &r;
+        explicit nested(reader &_r) : r(_r) {
+          if (++r.depth > max_depth) r.fail("nested too deeply");
+        }
+        ~nested() { r.depth--; }
+        nested(nested const &) = delete;
+        nested &operator=(nested const &) = delete;
+      };
+
+      [[noreturn]] void fail(char const *what) const {
+        throw std::runtime_error{std::string("Invalid json at offset ") + std::to_string(pos)
+                                 + ": " + what};
+      }
+
+      void skip_space() {
+        while (pos < text.size()
+               && (text[pos] == ' ' || text[pos] == '\n' || text[pos] == '\t'
+                   || text[pos] == '\r')) {
+          pos++;
+        }
+      }
+
+      void expect(char c) {
+        skip_space();
+        if (pos >= text.size() || text[pos] != c) fail("unexpected character");
+        pos++;
+      }
+
+      bool consume(std::string_view word) {
+        if (text.substr(pos, word.size()) != word) return false;
+        pos += word.size();
+        return true;
+      }
+
+      static void append_utf8(std::string &out, unsigned long cp) {
+        if (cp < 0x80) {
+          out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+          out += static_cast<char>(0xc0 | (cp >> 6));
+          out += static_cast<char>(0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+          out += static_cast<char>(0xe0 | (cp >> 12));
+          out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+          out += static_cast<char>(0x80 | (cp & 0x3f));
+        } else {
+          out += static_cast<char>(0xf0 | (cp >> 18));
+          out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+          out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+          out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+      }
+
+      unsigned long hex4() {
+        if (text.size() - pos < 4) fail("truncated escape");
+        auto const digits = std::string(text.substr(pos, 4));
+        char *end = nullptr;
+        auto const cp = std::strtoul(digits.c_str(), &end, 16);
+        if (end != digits.c_str() + 4) fail("invalid escape");
+        pos += 4;
+        return cp;
+      }
+
+      std::string parse_string() {
+        expect('"');
+
+        // Most strings have no escapes, and are copied whole
+        auto const *begin = text.data() + pos;
+        auto const *quote = static_cast<char const *>(std::memchr(begin, '"', text.size() - pos));
+        if (quote && !std::memchr(begin, '\\', static_cast<size_t>(quote - begin))) {
+          pos += static_cast<size_t>(quote - begin) + 1;
+          return std::string(begin, quote);
+        }
+
+        std::string out;
+        while (true) {
+          if (pos >= text.size()) fail("unterminated string");
+          auto const c = text[pos++];
+          if (c == '"') return out;
+          if (c != '\\') {
+            out += c;
+            continue;
+          }
+          if (pos >= text.size()) fail("unterminated string");
+          switch (auto const e = text[pos++]) {
+            case 'n':
+              out += '\n';
+              break;
+            case 't':
+              out += '\t';
+              break;
+            case 'r':
+              out += '\r';
+              break;
+            case 'b':
+              out += '\b';
+              break;
+            case 'f':
+              out += '\f';
+              break;
+            case 'u': {
+              auto cp = hex4();
+              if (cp >= 0xd800 && cp < 0xdc00 && consume("\\u")) {
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (hex4() - 0xdc00);
+              }
+              append_utf8(out, cp);
+              break;
+            }
+            default:
+              out += e;
+          }
+        }
+      }
+
+    public:
+      explicit reader(std::string_view _text) : text(_text) {}
+
+      value parse_value() {
+        skip_space();
+        if (pos >= text.size()) fail("unexpected end");
+        value v;
+        auto const c = text[pos];
+        if (c == '{') {
+          nested inside(*this);
+          v.type = value::kind::object;
+          pos++;
+          skip_space();
+          if (pos < text.size() && text[pos] == '}') {
+            pos++;
+            return v;
+          }
+          do {
+            auto key = parse_string();
+            expect(':');
+            v.object.emplace_back(std::move(key), parse_value());
+            skip_space();
+          } while (pos < text.size() && text[pos] == ',' && ++pos);
+          expect('}');
+        } else if (c == '[') {
+          nested inside(*this);
+          v.type = value::kind::array;
+          pos++;
+          skip_space();
+          if (pos < text.size() && text[pos] == ']') {
+            pos++;
+            return v;
+          }
+          do {
+            v.array.push_back(parse_value());
+            skip_space();
+          } while (pos < text.size() && text[pos] == ',' && ++pos);
+          expect(']');
+        } else if (c == '"') {
+          v.type = value::kind::string;
+          v.string = parse_string();
+        } else if (consume("true")) {
+          v.type = value::kind::boolean;
+          v.boolean = true;
+        } else if (consume("false")) {
+          v.type = value::kind::boolean;
+        } else if (consume("null")) {
+        } else {
+          auto const number = std::string(text.substr(pos, 32));
+          char *end = nullptr;
+          v.number = std::strtod(number.c_str(), &end);
+          if (end == number.c_str()) fail("unexpected character");
+          v.type = value::kind::number;
+          pos += static_cast<size_t>(end - number.c_str());
+        }
+        return v;
+      }
+
+      void finish() {
+        skip_space();
+        if (pos != text.size()) fail("trailing characters");
+      }
+    };
+  }  // namespace detail
+
+  // Read a document in place, one member at a time, without building values.
+  // For large documents of a known schema, that would not fit in memory twice.
+  class cursor : detail::reader {
+    // Skip a string whose opening quote was consumed
+    void skip_string() {
+      while (true) {
+        auto const *begin = text.data() + pos;
+        auto const *quote = static_cast<char const *>(std::memchr(begin, '"', text.size() - pos));
+        if (!quote) fail("unterminated string");
+        pos = static_cast<size_t>(quote - text.data()) + 1;
+
+        // The quote is escaped after an odd number of backslashes
+        size_t backslashes = 0;
+        while (quote - backslashes > begin && quote[-1 - static_cast<long>(backslashes)] == '\\') {
+          backslashes++;
+        }
+        if (backslashes % 2 == 0) return;
+      }
+    }
+
+  public:
+    explicit cursor(std::string_view _text) : detail::reader(_text) {}
+
+    // Call member(key) for each member of the object, which must read its value
+    template <typename F> void object(F &&member) {
+      expect('{');
+      nested inside(*this);
+      skip_space();
+      if (pos < text.size() && text[pos] == '}') {
+        pos++;
+        return;
+      }
+      do {
+        auto const key = parse_string();
+        expect(':');
+        member(std::string_view(key));
+        skip_space();
+      } while (pos < text.size() && text[pos] == ',' && ++pos);
+      expect('}');
+    }
+
+    // Call element() for each element of the array, which must read it
+    template <typename F> void array(F &&element) {
+      expect('[');
+      nested inside(*this);
+      skip_space();
+      if (pos < text.size() && text[pos] == ']') {
+        pos++;
+        return;
+      }
+      do {
+        element();
+        skip_space();
+      } while (pos < text.size() && text[pos] == ',' && ++pos);
+      expect(']');
+    }
+
+    std::string string() { return parse_string(); }
+
+    // A number, or a string holding one (as sizes are written)
+    double number() {
+      skip_space();
+      auto const v = parse_value();
+      if (v.type == value::kind::number) return v.number;
+      if (v.type == value::kind::string) {
+        char *end = nullptr;
+        auto const number = std::strtod(v.string.c_str(), &end);
+        if (end != v.string.c_str() && *end == '\0') return number;
+      }
+      fail("expected a number");
+    }
+
+    bool boolean() {
+      auto const v = parse_value();
+      if (v.type != value::kind::boolean) fail("expected true or false");
+      return v.boolean;
+    }
+
+    // Skip any value, returning its text
+    std::string_view skip() {
+      skip_space();
+      auto const start = pos;
+      if (pos < text.size() && (text[pos] == '{' || text[pos] == '[')) {
+        size_t depth = 0;
+        do {
+          if (pos >= text.size()) fail("unexpected end");
+          switch (text[pos++]) {
+            case '{':
+            case '[':
+              depth++;
+              break;
+            case '}':
+            case ']':
+              depth--;
+              break;
+            case '"':
+              skip_string();
+              break;
+            default:
+              break;
+          }
+        } while (depth > 0);
+      } else if (pos < text.size() && text[pos] == '"') {
+        pos++;
+        skip_string();
+      } else {
+        parse_value();
+      }
+      return text.substr(start, pos - start);
+    }
+
+    // Call read(), returning the text of the value it read
+    template <typename F> std::string_view raw(F &&read) {
+      skip_space();
+      auto const start = pos;
+      read();
+      return text.substr(start, pos - start);
+    }
+
+    void finish() { detail::reader::finish(); }
+  };
+
+  // Parse a whole json document, throwing std::runtime_error if it is not valid
+  inline value parse(std::string_view text) {
+    detail::reader reader(text);
+    auto v = reader.parse_value();
+    reader.finish();
+    return v;
+  }
+
+}  // namespace smeagle::json
@@ -0,0 +1,47 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace smeagle {
+
+  /**
+   * @brief Run task(i) for every index of costs in parallel, the largest cost first
+   *
+   * One puller per thread of the arena takes the next index of the sorted
+   * list, so the most expensive items start as early as possible instead of
+   * being left for the end. Once the list is empty, the threads that are done
+   * steal chunks of the parallel loops still running in the big items (see
+   * Smeagle::parse), which keeps every core busy until the last one finishes.
+   */
+  template <typename F> void largest_first(std::vector<std::uint64_t> const &costs, F &&task) {
+    std::vector<size_t> order(costs.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::stable_sort(order.begin(), order.end(),
+                     [&costs](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+    std::atomic<size_t> next{0};
+    auto const threads = static_cast<size_t>(std::max(1, tbb::this_task_arena::max_concurrency()));
+    tbb::task_group group;
+    for (size_t p = 0; p < std::min(threads, order.size()); p++) {
+      group.run([&]() {
+        for (auto k = next++; k < order.size(); k = next++) {
+          task(order[k]);
+        }
+      });
+    }
+    group.wait();
+  }
+
+}  // namespace smeagle
@@ -0,0 +1,301 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/layer.h"
+
+#include <elf.h>
+#include <tbb/task_group.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "json.hpp"
+#include "smeagle/elf.h"
+#include "smeagle/trace.h"
+
+using namespace smeagle;
+
+namespace {
+  constexpr size_t block_size = 512;
+
+  // Long names and pax records are small, larger extended headers are ignored
+  constexpr std::uint64_t max_extended_header = 1 << 20;
+
+  // Reads a (possibly gzip compressed) stream, zlib passes plain data through
+  class Reader {
+    gzFile file;
+    std::string name;
+
+  public:
+    explicit Reader(std::string const &path) : name(path) {
+      file = path == "-" ? gzdopen(dup(STDIN_FILENO), "rb") : gzopen(path.c_str(), "rb");
+      if (!file) {
+        throw std::runtime_error{"Cannot open '" + path + "'"};
+      }
+      gzbuffer(file, 256 * 1024);
+    }
+    ~Reader() { gzclose(file); }
+    Reader(Reader const &) = delete;
+    Reader &operator=(Reader const &) = delete;
+
+    // Read exactly size bytes, false at a clean end of stream
+    bool read(char *buffer, size_t size) {
+      size_t done = 0;
+      while (done < size) {
+        auto const chunk = std::min<size_t>(size - done, 1u << 30);
+        auto const n = gzread(file, buffer + done, static_cast<unsigned>(chunk));
+        if (n < 0) {
+          int code;
+          throw std::runtime_error{"Cannot read '" + name + "': " + gzerror(file, &code)};
+        }
+        if (n == 0) break;
+        done += static_cast<size_t>(n);
+      }
+      if (done != 0 && done != size) {
+        throw std::runtime_error{"'" + name + "' is truncated"};
+      }
+      return done == size;
+    }
+
+    // Read size bytes onto the end of buffer, which only grows as the data
+    // arrives, so a corrupt size in a header cannot allocate more than the
+    // stream holds
+    template <typename Buffer> void append(Buffer &buffer, std::uint64_t size) {
+      constexpr std::uint64_t chunk = 16 << 20;
+      while (size > 0) {
+        auto const n = static_cast<size_t>(std::min(size, chunk));
+        auto const at = buffer.size();
+        buffer.resize(at + n);
+        if (!read(buffer.data() + at, n)) {
+          throw std::runtime_error{"'" + name + "' is truncated"};
+        }
+        size -= n;
+      }
+    }
+
+    void skip(std::uint64_t size) {
+      char buffer[64 * 1024];
+      while (size > 0) {
+        auto const n = static_cast<size_t>(std::min<std::uint64_t>(size, sizeof buffer));
+        if (!read(buffer, n)) {
+          throw std::runtime_error{"'" + name + "' is truncated"};
+        }
+        size -= n;
+      }
+    }
+  };
+
+  std::string field(char const *header, size_t offset, size_t width) {
+    return std::string(header + offset, strnlen(header + offset, width));
+  }
+
+  // Sizes are octal, or base-256 (high bit set) when they do not fit
+  std::uint64_t number(char const *header, size_t offset, size_t width) {
+    auto const *p = reinterpret_cast<unsigned char const *>(header + offset);
+    std::uint64_t value = 0;
+    if (p[0] & 0x80) {
+      value = p[0] & 0x7f;
+      for (size_t i = 1; i < width; i++) value = (value << 8) | p[i];
+      return value;
+    }
+    for (size_t i = 0; i < width && p[i]; i++) {
+      if (p[i] >= '0' && p[i] <= '7') value = (value << 3) | (p[i] - '0');
+    }
+    return value;
+  }
+
+  // The "path" and "linkpath" records of a pax extended header
+  void read_pax(std::string const &records, std::string &path, std::string &linkpath) {
+    size_t pos = 0;
+    while (pos < records.size()) {
+      auto const space = records.find(' ', pos);
+      if (space == std::string::npos) break;
+      // A length that is not a number is a corrupt header, the rest is ignored
+      size_t length = 0;
+      auto const *digits = records.data() + pos;
+      auto const [end, error] = std::from_chars(digits, records.data() + space, length);
+      if (error != std::errc{} || end != records.data() + space) break;
+      if (length <= space - pos + 1 || length > records.size() - pos) break;
+      auto const record = records.substr(space + 1, pos + length - space - 2);
+      auto const equals = record.find('=');
+      if (equals != std::string::npos) {
+        auto const key = record.substr(0, equals);
+        if (key == "path") path = record.substr(equals + 1);
+        if (key == "linkpath") linkpath = record.substr(equals + 1);
+      }
+      pos += length;
+    }
+  }
+
+  std::string normalize(std::string path) {
+    while (path.compare(0, 2, "./") == 0) path.erase(0, 2);
+    if (path.empty() || path[0] != '/') path.insert(0, "/");
+    return path;
+  }
+
+  bool is_whiteout(std::string const &path) {
+    auto const slash = path.rfind('/');
+    return path.compare(slash + 1, 4, ".wh.") == 0;
+  }
+}  // namespace
+
+LayerCorpus::LayerCorpus(std::string _layer) : layer(std::move(_layer)) {}
+
+LayerCorpus::~LayerCorpus() {
+  // The corpora refer to types of the open objects, which refer to the bytes
+  for (auto &o : objects) {
+    o.corpus.reset();
+    if (o.smeagle) o.smeagle->close();
+  }
+}
+
+void LayerCorpus::parse(Stats *stats) {
+  SMEAGLE_TRACE_SPAN("layer", "parse", layer);
+  Reader reader(layer);
+  tbb::task_group parsing;
+  std::unordered_map<std::string, std::string> by_path;
+
+  // Stop the parses in flight before anything goes out of scope
+  struct waiter {
+    tbb::task_group &group;
+    ~waiter() { group.wait(); }
+  } wait_on_exit{parsing};
+
+  char header[block_size];
+  std::string long_path, long_link;
+  while (reader.read(header, block_size)) {
+    // The archive ends with zero blocks
+    if (header[0] == '\0') break;
+
+    auto const type = header[156];
+    auto const size = number(header, 124, 12);
+    if (size > UINT64_MAX - block_size) {
+      throw std::runtime_error{"'" + layer + "' has a corrupt header"};
+    }
+    auto const padded = (size + block_size - 1) / block_size * block_size;
+
+    std::string path = field(header, 0, 100);
+    if (std::memcmp(header + 257, "ustar", 5) == 0 && header[345]) {
+      path = field(header, 345, 155) + "/" + path;
+    }
+    std::string link = field(header, 157, 100);
+
+    // Headers that describe the entry that follows them
+    if (type == 'L' || type == 'K' || type == 'x') {
+      if (size > max_extended_header) {
+        reader.skip(padded);
+        continue;
+      }
+      std::string data;
+      reader.append(data, padded);
+      data.resize(size);
+      if (type == 'L') long_path = data.c_str();
+      if (type == 'K') long_link = data.c_str();
+      if (type == 'x') read_pax(data, long_path, long_link);
+      continue;
+    }
+    if (!long_path.empty()) path = long_path;
+    if (!long_link.empty()) link = long_link;
+    long_path.clear();
+    long_link.clear();
+    path = normalize(path);
+
+    if (type == '1') {
+      if (auto found = by_path.find(normalize(link)); found != by_path.end()) {
+        links[path] = found->second;
+      }
+      continue;
+    }
+
+    // Only regular files large enough to be ELF objects are looked at
+    if ((type != '0' && type != '\0') || size < sizeof(Elf64_Ehdr) || is_whiteout(path)) {
+      reader.skip(padded);
+      continue;
+    }
+
+    char start[sizeof(Elf64_Ehdr)];
+    if (!reader.read(start, sizeof start)) {
+      throw std::runtime_error{"'" + layer + "' is truncated"};
+    }
+    if (!elf::has_magic(start, sizeof start)) {
+      reader.skip(padded - sizeof start);
+      continue;
+    }
+
+    std::vector<char> bytes(start, start + sizeof start);
+    reader.append(bytes, padded - sizeof start);
+    bytes.resize(size);
+
+    try {
+      if (!elf::File(bytes.data(), bytes.size(), path).is_shared_library()) {
+        continue;
+      }
+    } catch (std::runtime_error const &) {
+      continue;
+    }
+
+    auto &o = objects.emplace_back();
+    o.path = path;
+    o.bytes = std::move(bytes);
+    o.smeagle = std::make_unique<Smeagle>(layer + ":" + path, o.bytes.data(), o.bytes.size());
+    o.smeagle->setStats(stats);
+    o.smeagle->setTypeCache(&types);
+    by_path[path] = path;
+
+    parsing.run([&o] {
+      SMEAGLE_TRACE_SPAN("layer", "library", o.path);
+      try {
+        o.corpus.emplace(o.smeagle->parse());
+      } catch (std::exception const &e) {
+        o.error = e.what();
+      }
+    });
+  }
+}
+
+void LayerCorpus::toJson(std::ostream &out) const {
+  out << "{\n\"layer\": ";
+  json::write_string(out, layer);
+
+  out << ",\n\"links\": {";
+  auto first = true;
+  for (auto const &[path, target] : links) {
+    out << (first ? "\n" : ",\n") << "  ";
+    first = false;
+    json::write_string(out, path);
+    out << ": ";
+    json::write_string(out, target);
+  }
+
+  out << "\n},\n\"errors\": {";
+  first = true;
+  for (auto const &o : objects) {
+    if (o.corpus) continue;
+    out << (first ? "\n" : ",\n") << "  ";
+    first = false;
+    json::write_string(out, o.path);
+    out << ": ";
+    json::write_string(out, o.error);
+  }
+
+  out << "\n},\n\"corpora\": {";
+  first = true;
+  for (auto const &o : objects) {
+    if (!o.corpus) continue;
+    out << (first ? "\n" : ",\n");
+    first = false;
+    json::write_string(out, o.path);
+    out << ":\n";
+    o.corpus->toJson(out);
+  }
+  out << "\n}\n}\n";
+}
@@ -0,0 +1,52 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace smeagle {
+
+  // Map a whole file read-only (throws std::runtime_error if it cannot be mapped)
+  inline std::pair<char const *, size_t> map_file(std::string const &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::runtime_error{"Cannot open '" + path + "'"};
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      close(fd);
+      throw std::runtime_error{"'" + path + "' is empty or cannot be read"};
+    }
+    auto const length = static_cast<size_t>(st.st_size);
+    void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      throw std::runtime_error{"Cannot map '" + path + "'"};
+    }
+    return {static_cast<char const *>(p), length};
+  }
+
+  inline void unmap_file(char const *base, size_t length) {
+    munmap(const_cast<char *>(base), length);
+  }
+
+  // A copy of the file, which the linker may rewrite in place while we read it
+  inline std::vector<char> read_file(std::string const &path) {
+    auto const [data, size] = map_file(path);
+    std::vector<char> bytes(data, data + size);
+    unmap_file(data, size);
+    return bytes;
+  }
+
+}  // namespace smeagle
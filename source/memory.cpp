@@ -0,0 +1,52 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/memory.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+
+using namespace smeagle;
+
+namespace {
+  std::atomic<bool> counting{false};
+
+  // Trivially initialized, so it is safe to touch from inside operator new
+  thread_local std::uint64_t allocated = 0;
+}  // namespace
+
+void memory::enable() { counting.store(true, std::memory_order_relaxed); }
+
+void memory::disable() { counting.store(false, std::memory_order_relaxed); }
+
+bool memory::enabled() { return counting.load(std::memory_order_relaxed); }
+
+std::uint64_t memory::thread_allocated() { return allocated; }
+
+void memory::note_allocation(std::size_t bytes) {
+  if (counting.load(std::memory_order_relaxed)) {
+    allocated += bytes;
+  }
+}
+
+std::uint64_t memory::peak_rss() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+
+  // Linux reports kilobytes
+  return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+std::uint64_t memory::current_rss() {
+  unsigned long size = 0, resident = 0;
+  if (auto *f = std::fopen("/proc/self/statm", "r")) {
+    if (std::fscanf(f, "%lu %lu", &size, &resident) != 2) resident = 0;
+    std::fclose(f);
+  }
+  return static_cast<std::uint64_t>(resident) * sysconf(_SC_PAGESIZE);
+}
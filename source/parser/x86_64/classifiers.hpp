@@ -5,11 +5,15 @@
 
 #pragma once
 
+#include <charconv>
+#include <iterator>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "Type.h"
 #include "register_class.hpp"
+#include "smeagle/type_cache.h"
 #include "type_checker.hpp"
 
 namespace smeagle::x86_64 {
@@ -176,26 +180,122 @@ namespace smeagle::x86_64 {
     }
   }
 
-  // Classify the whole struct
-  inline classification classify(st::typeStruct *t) {
-    const auto size = t->getSize();
+  // Append the layout of a type as far as classifying it goes: what kind of
+  // type it is and its size, down to the scalars (pointers end it). Names are
+  // left out, as two types of the same name can be laid out differently.
+  inline void fingerprint(st::Type *type, std::string &out) {
+    auto [t, ptr_cnt] = unwrap_underlying_type(type);
+    if (ptr_cnt > 0) {
+      out += '*';
+      return;
+    }
+    // Sizes and offsets are appended without a temporary string each
+    auto number = [&out](char kind, long long n) {
+      char digits[24];
+      auto end = std::to_chars(std::begin(digits), std::end(digits), n).ptr;
+      out += kind;
+      out.append(digits, end);
+    };
+    auto fields = [&](char kind, st::Type *aggregate, std::vector<st::Field *> const &members) {
+      number(kind, aggregate->getSize());
+      out += '{';
+      for (auto *f : members) {
+        number(',', f->getOffset());
+        out += ':';
+        fingerprint(f->getType(), out);
+      }
+      out += '}';
+    };
+    if (auto *scalar = t->getScalarType()) {
+      auto const &props = scalar->properties();
+      number('s', t->getSize());
+      out += props.is_integral ? 'i' : '-';
+      out += props.is_UTF ? 'u' : '-';
+      out += props.is_floating_point ? 'f' : '-';
+      out += props.is_complex_float ? 'c' : '-';
+    } else if (auto *s = t->getStructType()) {
+      fields('S', s, *s->getFields());
+    } else if (auto *u = t->getUnionType()) {
+      fields('U', u, *u->getComponents());
+    } else if (auto *a = t->getArrayType()) {
+      number('a', t->getSize());
+      fingerprint(a->getBaseType(), out);
+    } else if (t->getEnumType()) {
+      number('e', t->getSize());
+    } else if (t->getFunctionType()) {
+      out += 'f';
+    } else {
+      out += '?';
+    }
+  }
 
-    // If an object is larger than eight eightbyes (i.e., 64) class MEMORY.
-    if (size > 64) {
-      return {RegisterClass::MEMORY, RegisterClass::NO_CLASS, "Struct"};
+  // Classify an aggregate with compute, remembering it in the scope of this
+  // thread and going through the shared cache when there is one
+  template <typename T, typename F>
+  classification cached_classify(T *t, char const *kind, F &&compute) {
+    auto *scope = TypeCache::Scope::current();
+    if (!scope) {
+      return compute();
+    }
+    if (auto seen = scope->recall(t)) {
+      return {static_cast<RegisterClass>(seen->lo), static_cast<RegisterClass>(seen->hi), kind, 0};
     }
 
-    RegisterClass hi = RegisterClass::NO_CLASS;
-    RegisterClass lo = RegisterClass::NO_CLASS;
-    for (auto *f : *t->getFields()) {
-      auto c = classify(f);
-      hi = merge(hi, c.hi);
-      lo = merge(lo, c.lo);
+    // Only the outermost aggregate is fingerprinted and looked up, the ones
+    // inside it are classified along with it. Larger aggregates are in
+    // memory, without looking at their fields.
+    auto *cache = scope->getCache();
+    auto const shared = cache && !scope->nested() && t->getSize() <= 64;
+    std::string key;
+    if (shared) {
+      key.reserve(256);
+      key = "x86_64:";
+      fingerprint(t, key);
+      if (auto hit = cache->find(key)) {
+        scope->remember(t, *hit);
+        return {static_cast<RegisterClass>(hit->lo), static_cast<RegisterClass>(hit->hi), kind, 0};
+      }
+    }
+
+    struct nesting {
+      TypeCache::Scope *scope;
+      explicit nesting(TypeCache::Scope *s) : scope(s) { scope->enter(); }
+      ~nesting() { scope->leave(); }
+    };
+    auto c = [&] {
+      nesting inside(scope);
+      return compute();
+    }();
+    TypeCache::entry const value{static_cast<int>(c.lo), static_cast<int>(c.hi)};
+    scope->remember(t, value);
+    if (shared) {
+      cache->insert(key, value);
     }
+    return c;
+  }
+
+  // Classify the whole struct
+  inline classification classify(st::typeStruct *t) {
+    return cached_classify(t, "Struct", [t]() -> classification {
+      const auto size = t->getSize();
+
+      // If an object is larger than eight eightbyes (i.e., 64) class MEMORY.
+      if (size > 64) {
+        return {RegisterClass::MEMORY, RegisterClass::NO_CLASS, "Struct"};
+      }
+
+      RegisterClass hi = RegisterClass::NO_CLASS;
+      RegisterClass lo = RegisterClass::NO_CLASS;
+      for (auto *f : *t->getFields()) {
+        auto c = classify(f);
+        hi = merge(hi, c.hi);
+        lo = merge(lo, c.lo);
+      }
 
-    // Pass a reference so they are updated here, and we also need size
-    post_merge(lo, hi, size);
-    return {lo, hi, "Struct"};
+      // Pass a reference so they are updated here, and we also need size
+      post_merge(lo, hi, size);
+      return {lo, hi, "Struct"};
+    });
   }
 
   // Classify the fields
@@ -208,22 +308,24 @@ namespace smeagle::x86_64 {
   }
 
   inline classification classify(st::typeUnion *t) {
-    const auto size = t->getSize();
-    if (size > 64) {
-      return {RegisterClass::MEMORY, RegisterClass::NO_CLASS, "Union"};
-    }
+    return cached_classify(t, "Union", [t]() -> classification {
+      const auto size = t->getSize();
+      if (size > 64) {
+        return {RegisterClass::MEMORY, RegisterClass::NO_CLASS, "Union"};
+      }
 
-    RegisterClass hi = RegisterClass::NO_CLASS;
-    RegisterClass lo = RegisterClass::NO_CLASS;
-    for (auto *f : *t->getComponents()) {
-      auto c = classify(f);
-      hi = merge(hi, c.hi);
-      lo = merge(lo, c.lo);
-    }
+      RegisterClass hi = RegisterClass::NO_CLASS;
+      RegisterClass lo = RegisterClass::NO_CLASS;
+      for (auto *f : *t->getComponents()) {
+        auto c = classify(f);
+        hi = merge(hi, c.hi);
+        lo = merge(lo, c.lo);
+      }
 
-    // Pass a reference so they are updated here, and we also need size
-    post_merge(lo, hi, size);
-    return {lo, hi, "Union"};
+      // Pass a reference so they are updated here, and we also need size
+      post_merge(lo, hi, size);
+      return {lo, hi, "Union"};
+    });
   }
 
   inline classification classify(st::typeArray *t) {
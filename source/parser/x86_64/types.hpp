@@ -68,8 +68,8 @@ namespace smeagle::x86_64::types {
   template <typename T> struct union_t final : detail::param {
     T *dyninst_obj;
 
-    // Keep track of all of the typenames we've seen.
-    inline static std::unordered_set<std::string> seen;
+    // Keep track of the typenames we've seen (per thread, as corpora can be written in parallel)
+    inline static thread_local std::unordered_set<std::string> seen;
 
     struct recursive_t final {};
 
@@ -119,8 +119,8 @@ namespace smeagle::x86_64::types {
   };
   template <typename T> struct struct_t final : detail::param {
     T *dyninst_obj;
-    // Keep track of all of the typenames we've seen.
-    inline static std::unordered_set<std::string> seen;
+    // Keep track of the typenames we've seen (per thread, as corpora can be written in parallel)
+    inline static thread_local std::unordered_set<std::string> seen;
 
     struct recursive_t final {};
 
@@ -14,6 +14,7 @@
 #include "classifiers.hpp"
 #include "smeagle/abi_description.h"
 #include "smeagle/parameter.h"
+#include "smeagle/stats.h"
 #include "type_checker.hpp"
 #include "types.hpp"
 
@@ -86,6 +87,20 @@ namespace smeagle::x86_64 {
                                       base_type->getSize(), std::forward<Args>(args)...}};
   }
 
+  // Attribute the time spent in an allocator to the Allocate phase
+  template <typename Allocator> class TimedAllocator {
+    Allocator &allocator;
+    Stats *stats;
+
+  public:
+    TimedAllocator(Allocator &_allocator, Stats *_stats) : allocator(_allocator), stats(_stats) {}
+
+    std::string getRegisterString(RegisterClass lo, RegisterClass hi, st::Type *paramType) {
+      PhaseTimer timer(stats, Phase::Allocate);
+      return allocator.getRegisterString(lo, hi, paramType);
+    }
+  };
+
   smeagle::abi_variable_description parse_variable(st::Symbol *symbol) {
     smeagle::abi_variable_description description;
     auto variable = symbol->getVariable();
@@ -95,15 +110,23 @@ namespace smeagle::x86_64 {
     return description;
   }
 
-  std::vector<parameter> parse_parameters(st::Symbol *symbol) {
+  std::vector<parameter> parse_parameters(st::Symbol *symbol, Stats *stats) {
     st::Function *func = symbol->getFunction();
     std::vector<st::localVar *> params;
 
     std::vector<parameter> typelocs;
 
+    bool has_params;
+    {
+      PhaseTimer timer(stats, Phase::Params);
+      has_params = func->getParams(params);
+    }
+
     // Get parameters with types and names
-    if (func->getParams(params)) {
-      RegisterAllocator allocator;
+    if (has_params) {
+      RegisterAllocator registers;
+      TimedAllocator<RegisterAllocator> allocator(registers, stats);
+      if (stats) stats->add(Counter::Types, params.size());
 
       for (auto &param : params) {
         auto param_name = param->getName();
@@ -138,7 +161,7 @@ namespace smeagle::x86_64 {
     return typelocs;
   }
 
-  parameter parse_return_value(Dyninst::SymtabAPI::Symbol const *sym) {
+  parameter parse_return_value(Dyninst::SymtabAPI::Symbol const *sym, Stats *stats) {
     st::Function *func = sym->getFunction();
     st::Type *ret_t = func->getReturnType();
 
@@ -146,7 +169,9 @@ namespace smeagle::x86_64 {
       return smeagle::parameter{types::void_t{}};
     }
 
-    ReturnValueAllocator allocator;
+    ReturnValueAllocator registers;
+    TimedAllocator<ReturnValueAllocator> allocator(registers, stats);
+    if (stats) stats->add(Counter::Types);
     auto [underlying_type, ptr_cnt] = unwrap_underlying_type(ret_t);
     if (auto *t = underlying_type->getScalarType()) {
       return classify<types::scalar_t>("", t, ret_t, allocator, ptr_cnt);
@@ -10,10 +10,12 @@
 #include "Symtab.h"
 #include "smeagle/abi_description.h"
 #include "smeagle/parameter.h"
+#include "smeagle/stats.h"
 
 namespace smeagle::x86_64 {
 
-  std::vector<parameter> parse_parameters(Dyninst::SymtabAPI::Symbol* symbol);
-  parameter parse_return_value(Dyninst::SymtabAPI::Symbol const* symbol);
+  std::vector<parameter> parse_parameters(Dyninst::SymtabAPI::Symbol* symbol,
+                                          Stats* stats = nullptr);
+  parameter parse_return_value(Dyninst::SymtabAPI::Symbol const* symbol, Stats* stats = nullptr);
   smeagle::abi_variable_description parse_variable(Dyninst::SymtabAPI::Symbol* symbol);
 }  // namespace smeagle::x86_64
@@ -0,0 +1,102 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+
+using namespace smeagle;
+
+namespace {
+  struct event_config {
+    std::uint32_t type;
+    std::uint64_t config;
+  };
+
+  // Indexed by perf::Event
+  constexpr event_config configs[perf::num_events] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+  };
+
+  // Open a single counter for the calling thread on any cpu, -1 on failure
+  int open_counter(event_config const &c) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = c.type;
+    attr.config = c.config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // Processes we start (like batch workers) must not inherit the counters
+    return static_cast<int>(
+        syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+  }
+
+  // Events are opened separately (not as a group) so that, e.g., a VM
+  // without a PMU still gets page faults.
+  struct thread_counters {
+    int fds[perf::num_events];
+
+    thread_counters() {
+      for (size_t i = 0; i < perf::num_events; i++) {
+        fds[i] = open_counter(configs[i]);
+      }
+    }
+    ~thread_counters() {
+      for (int fd : fds) {
+        if (fd >= 0) close(fd);
+      }
+    }
+    thread_counters(thread_counters const &) = delete;
+    thread_counters &operator=(thread_counters const &) = delete;
+  };
+
+  thread_counters &local_counters() {
+    thread_local thread_counters counters;
+    return counters;
+  }
+}  // namespace
+
+perf::Sample perf::read() {
+  Sample sample;
+  auto &counters = local_counters();
+  for (size_t i = 0; i < num_events; i++) {
+    std::uint64_t value = 0;
+    if (counters.fds[i] >= 0 && ::read(counters.fds[i], &value, sizeof value) == sizeof value) {
+      sample.values[i] = value;
+      sample.valid[i] = true;
+    }
+  }
+  return sample;
+}
+
+bool perf::supported() {
+  for (int fd : local_counters().fds) {
+    if (fd >= 0) return true;
+  }
+  return false;
+}
+
+char const *perf::name(Event event) {
+  switch (event) {
+    case Event::Cycles:
+      return "cycles";
+    case Event::Instructions:
+      return "instructions";
+    case Event::CacheMisses:
+      return "cache_misses";
+    case Event::PageFaults:
+      return "page_faults";
+    default:
+      return "unknown";
+  }
+}
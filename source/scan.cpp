@@ -0,0 +1,219 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/scan.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "json.hpp"
+#include "smeagle/elf.h"
+
+using namespace smeagle;
+namespace fs = std::filesystem;
+
+namespace {
+  std::uint64_t fnv1a(std::string const &s) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : s) {
+      hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+  }
+}  // namespace
+
+ScanResult smeagle::scan(std::string const &root) {
+  std::error_code ec;
+  if (!fs::is_directory(root, ec)) {
+    throw std::runtime_error{"'" + root + "' is not a directory"};
+  }
+
+  // Sorting first makes the canonical path of each group deterministic
+  std::vector<std::string> paths;
+  auto options = fs::directory_options::skip_permission_denied;
+  for (auto it = fs::recursive_directory_iterator(root, options, ec);
+       !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (it->is_regular_file(ec)) {
+      paths.push_back(it->path().string());
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+
+  ScanResult result;
+
+  // Group by inode, so symlinks and hard links are only opened once
+  std::map<std::pair<std::uint64_t, std::uint64_t>, std::string> by_inode;
+  std::map<std::string, std::string> by_build_id;
+  std::map<std::string, std::string> inode_canonical;
+
+  for (auto const &path : paths) {
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) continue;
+    auto const key
+        = std::make_pair(static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino));
+
+    auto [seen, inserted] = by_inode.emplace(key, path);
+    if (!inserted) {
+      if (auto found = inode_canonical.find(seen->second); found != inode_canonical.end()) {
+        result.canonical[path] = found->second;
+      }
+      continue;
+    }
+
+    if (!elf::has_magic(path)) continue;
+
+    std::string build_id;
+    try {
+      elf::File file(path);
+      if (!file.is_shared_library()) continue;
+      build_id = file.build_id();
+    } catch (std::runtime_error const &) {
+      continue;
+    }
+
+    // Then by build-id, so identical builds in different places are parsed once
+    auto canonical = path;
+    if (!build_id.empty()) {
+      canonical = by_build_id.emplace(build_id, path).first->second;
+    }
+    if (canonical == path) {
+      result.libraries.push_back(path);
+      result.build_ids[path] = build_id;
+      result.sizes[path] = static_cast<std::uint64_t>(st.st_size);
+    }
+    inode_canonical[path] = canonical;
+    result.canonical[path] = canonical;
+  }
+  return result;
+}
+
+std::string ScanResult::corpusName(std::string const &library) const {
+  if (auto found = build_ids.find(library); found != build_ids.end() && !found->second.empty()) {
+    return found->second + ".json";
+  }
+  char hash[17];
+  std::snprintf(hash, sizeof hash, "%016llx", static_cast<unsigned long long>(fnv1a(library)));
+  return std::string(hash) + ".json";
+}
+
+void ScanResult::toJson(std::ostream &out, std::map<std::string, std::string> const &errors,
+                        bool with_corpora) const {
+  out << "{\n\"corpora\": {";
+  auto first = true;
+  for (auto const &library : libraries) {
+    out << (first ? "\n" : ",\n") << "  ";
+    first = false;
+    json::write_string(out, library);
+    out << ": {\"build_id\": ";
+    json::write_string(out, build_ids.at(library));
+    if (with_corpora) {
+      out << ", \"corpus\": ";
+      json::write_string(out, corpusName(library));
+    }
+    if (auto error = errors.find(library); error != errors.end()) {
+      out << ", \"error\": ";
+      json::write_string(out, error->second);
+    }
+    out << "}";
+  }
+  out << "\n},\n\"paths\": {";
+  first = true;
+  for (auto const &[path, library] : canonical) {
+    out << (first ? "\n" : ",\n") << "  ";
+    first = false;
+    json::write_string(out, path);
+    out << ": ";
+    json::write_string(out, library);
+  }
+  out << "\n}\n}\n";
+}
+
+ScanResult ScanResult::shard(size_t index, size_t count) const {
+  if (count == 0 || index >= count) {
+    throw std::runtime_error{"Invalid shard " + std::to_string(index) + " of "
+                             + std::to_string(count)};
+  }
+
+  auto size_of = [this](std::string const &library) {
+    auto found = sizes.find(library);
+    return found == sizes.end() ? std::uint64_t{0} : found->second;
+  };
+  std::vector<std::tuple<std::uint64_t, std::string, std::string>> order;
+  for (auto const &library : libraries) {
+    order.emplace_back(size_of(library), corpusName(library), library);
+  }
+  std::sort(order.begin(), order.end(), [](auto const &a, auto const &b) {
+    if (std::get<0>(a) != std::get<0>(b)) return std::get<0>(a) > std::get<0>(b);
+    return std::tie(std::get<1>(a), std::get<2>(a)) < std::tie(std::get<1>(b), std::get<2>(b));
+  });
+
+  // The least loaded shard (and the lowest numbered of those) takes the next library
+  using load = std::pair<std::uint64_t, size_t>;
+  std::priority_queue<load, std::vector<load>, std::greater<load>> shards;
+  for (size_t i = 0; i < count; i++) {
+    shards.push({0, i});
+  }
+
+  ScanResult part;
+  for (auto const &[size, name, library] : order) {
+    auto [bytes, shard] = shards.top();
+    shards.pop();
+    shards.push({bytes + size, shard});
+    if (shard == index) {
+      part.libraries.push_back(library);
+      part.build_ids[library] = build_ids.at(library);
+      part.sizes[library] = size;
+    }
+  }
+  std::sort(part.libraries.begin(), part.libraries.end());
+
+  for (auto const &[path, library] : canonical) {
+    if (part.build_ids.count(library)) {
+      part.canonical[path] = library;
+    }
+  }
+  return part;
+}
+
+void ScanResult::merge(ScanResult const &other) {
+  std::vector<std::string> all;
+  std::set_union(libraries.begin(), libraries.end(), other.libraries.begin(),
+                 other.libraries.end(), std::back_inserter(all));
+  libraries = std::move(all);
+  canonical.insert(other.canonical.begin(), other.canonical.end());
+  build_ids.insert(other.build_ids.begin(), other.build_ids.end());
+  sizes.insert(other.sizes.begin(), other.sizes.end());
+}
+
+ScanResult smeagle::readIndex(std::istream &in, std::map<std::string, std::string> *errors) {
+  std::string const text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+  auto const index = json::parse(text);
+
+  ScanResult result;
+  for (auto const &[library, entry] : index.at("corpora").object) {
+    result.libraries.push_back(library);
+    result.build_ids[library] = entry.at("build_id").string;
+    if (auto const *error = entry.find("error"); error && errors) {
+      (*errors)[library] = error->string;
+    }
+  }
+  std::sort(result.libraries.begin(), result.libraries.end());
+  for (auto const &[path, library] : index.at("paths").object) {
+    result.canonical[path] = library.string;
+  }
+  return result;
+}
@@ -0,0 +1,204 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "json.hpp"
+#include "smeagle/diff.h"
+
+using namespace smeagle;
+
+namespace {
+  // A client whose request grows past this without a newline is hung up on
+  constexpr size_t max_request = 1 << 20;
+
+  // Send all of a buffer, false if the client went away
+  bool send_all(int fd, char const *data, size_t size) {
+    while (size > 0) {
+      auto n = send(fd, data, size, MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      data += n;
+      size -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  std::vector<std::string> split(std::string const &line) {
+    std::vector<std::string> words;
+    std::istringstream in(line);
+    for (std::string word; in >> word;) {
+      words.push_back(std::move(word));
+    }
+    return words;
+  }
+}  // namespace
+
+Server::Server(std::string _socket_path, size_t cache_capacity)
+    : socket_path(std::move(_socket_path)), cache(cache_capacity) {}
+
+Server::~Server() { stop(); }
+
+void Server::stop() {
+  stopping.store(true);
+
+  // shutdown is async-signal-safe, and wakes up the accept in run
+  auto fd = listen_fd.load();
+  if (fd >= 0) {
+    shutdown(fd, SHUT_RDWR);
+  }
+}
+
+void Server::run() {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error{"Socket path is too long: '" + socket_path + "'"};
+  }
+  std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    throw std::runtime_error{std::string{"Cannot create socket: "} + std::strerror(errno)};
+  }
+
+  // Replace a socket left behind by a previous server, unless that is still running
+  if (int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0); probe >= 0) {
+    auto const live = connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof addr) == 0;
+    ::close(probe);
+    if (live) {
+      ::close(fd);
+      throw std::runtime_error{"A server is already listening on '" + socket_path + "'"};
+    }
+  }
+  unlink(socket_path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0 || listen(fd, 128) != 0) {
+    auto const reason = std::strerror(errno);
+    ::close(fd);
+    throw std::runtime_error{"Cannot listen on '" + socket_path + "': " + reason};
+  }
+  listen_fd.store(fd);
+
+  while (!stopping.load()) {
+    int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      break;
+    }
+    connections++;
+    {
+      std::lock_guard<std::mutex> guard(clients_lock);
+      client_fds.insert(client);
+    }
+    std::thread(&Server::serve, this, client).detach();
+  }
+
+  // Hang up on everybody and wait for the client threads to finish
+  {
+    std::unique_lock<std::mutex> guard(clients_lock);
+    for (int client : client_fds) {
+      shutdown(client, SHUT_RDWR);
+    }
+    clients_done.wait(guard, [this] { return client_fds.empty(); });
+  }
+  listen_fd.store(-1);
+  ::close(fd);
+  unlink(socket_path.c_str());
+}
+
+void Server::serve(int fd) {
+  std::string pending;
+  char buffer[4096];
+
+  for (;;) {
+    auto n = read(fd, buffer, sizeof buffer);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    pending.append(buffer, static_cast<size_t>(n));
+
+    // Answer every complete line we have
+    bool connected = true;
+    for (auto eol = pending.find('\n'); connected && eol != std::string::npos;
+         eol = pending.find('\n')) {
+      auto const request = pending.substr(0, eol);
+      pending.erase(0, eol + 1);
+
+      std::string payload;
+      auto const ok = respond(request, payload);
+      auto const header = std::string{ok ? "ok " : "error "} + std::to_string(payload.size()) + "\n";
+      connected = send_all(fd, header.data(), header.size())
+                  && send_all(fd, payload.data(), payload.size());
+    }
+    if (!connected || pending.size() > max_request) break;
+  }
+
+  std::lock_guard<std::mutex> guard(clients_lock);
+  client_fds.erase(fd);
+  ::close(fd);
+  clients_done.notify_all();
+}
+
+bool Server::respond(std::string const &request, std::string &payload) {
+  requests++;
+  auto const words = split(request);
+  std::ostringstream out;
+
+  try {
+    auto const command = words.empty() ? std::string{} : words[0];
+
+    if (command == "parse" && words.size() == 2) {
+      auto entry = cache.get(words[1]);
+      entry->corpus().toJson(out);
+
+    } else if (command == "lookup" && words.size() == 3) {
+      auto entry = cache.get(words[1]);
+      if (!entry->corpus().symbolToJson(words[2], out)) {
+        throw std::runtime_error{"No symbol '" + words[2] + "' in '" + words[1] + "'"};
+      }
+
+    } else if (command == "diff" && words.size() == 3) {
+      auto older = cache.get(words[1]);
+      auto newer = cache.get(words[2]);
+      diff(older->corpus(), newer->corpus()).toJson(out);
+
+    } else if (command == "has-exceptions" && words.size() == 2) {
+      auto entry = cache.get(words[1]);
+      out << "{\"library\": ";
+      json::write_string(out, words[1]);
+      out << ", \"has_exceptions\": " << (entry->hasExceptions() ? "true" : "false") << "}\n";
+
+    } else if (command == "stats" && words.size() == 1) {
+      std::lock_guard<std::mutex> guard(clients_lock);
+      out << "{\"requests\": " << requests.load() << ", \"failures\": " << failures.load()
+          << ", \"connections\": " << connections.load()
+          << ", \"active_clients\": " << client_fds.size() << ", \"cache\": ";
+      cache.toJson(out);
+      out << "}\n";
+
+    } else {
+      throw std::runtime_error{"Unknown request '" + request
+                               + "' (expected parse, lookup, diff, has-exceptions or stats)"};
+    }
+  } catch (std::exception const &e) {
+    failures++;
+    payload = e.what();
+    return false;
+  }
+  payload = out.str();
+  return true;
+}
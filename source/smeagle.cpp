@@ -4,82 +4,520 @@
 // SPDX-License-Identifier: (Apache-2.0 OR MIT)
 
 #include <smeagle/corpora.h>
+#include <smeagle/decompress.h>
+#include <smeagle/dwarf.h>
+#include <smeagle/elf.h>
+#include <smeagle/memory.h>
 #include <smeagle/smeagle.h>
+#include <smeagle/trace.h>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "Function.h"
+#include "Module.h"
 #include "Symtab.h"
+#include "hasher.hpp"
 
 using namespace Dyninst;
 using namespace SymtabAPI;
 using namespace smeagle;
 
+namespace {
+  // Can another library bind to this (defined) symbol?
+  bool is_exported(Symbol *symbol) {
+    auto const linkage = symbol->getLinkage();
+    if (linkage != Symbol::SL_GLOBAL && linkage != Symbol::SL_WEAK && linkage != Symbol::SL_UNIQUE) {
+      return false;
+    }
+    switch (symbol->getType()) {
+      case Symbol::ST_FUNCTION:
+      case Symbol::ST_OBJECT:
+      case Symbol::ST_TLS:
+      case Symbol::ST_INDIRECT:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Relocatable objects (archive members) have no dynamic symbol table,
+  // all of their global symbols are the interface instead
+  bool in_interface(Symbol *symbol, bool relocatable) {
+    return relocatable ? symbol->isInSymtab() && is_exported(symbol) : symbol->isInDynSymtab();
+  }
+
+  // Does describing this symbol of the interface need the DWARF types?
+  bool needs_types(Symbol *symbol) {
+    return symbol->isFunction()
+           || (symbol->isVariable() && symbol->getLinkage() == Symbol::SL_GLOBAL);
+  }
+
+  // Keep the version of everything another library can bind to
+  void add_export(Corpus &corpus, Symbol *symbol) {
+    if (is_exported(symbol)) {
+      corpus.parseExport(symbol);
+    }
+  }
+
+  // Add what we know about one symbol of the interface to a corpus. The
+  // types come from typed, the same symbol in the debug file (if there is one).
+  void describe(Corpus &corpus, Symbol *symbol, Symbol *typed, Architecture architecture,
+                Stats *stats) {
+    add_export(corpus, symbol);
+
+    // If It's a function, parse the parameters
+    if (symbol->isFunction()) {
+      corpus.parseFunctionABILocation(typed, architecture, stats);
+
+      // If it's a variable and not a function
+    } else if (symbol->isVariable()) {
+      // Do we have a global variable?
+      if (symbol->getLinkage() == Symbol::SL_GLOBAL) {
+        corpus.parseVariableABILocation(typed, architecture, stats);
+      }
+    }
+
+    // The symbol is something else (we likely want a subset of these?)
+
+    // else {
+    // std::cout << "symbol_notparsed(" <<  sname << ")" << "\n";
+    //}
+  }
+
+  // Imported symbols, with the versions they require
+  void add_imports(Corpus &corpus, Symtab *symtab, bool relocatable) {
+    std::vector<Symbol *> undefined;
+    symtab->getAllUndefinedSymbols(undefined);
+    for (auto &symbol : undefined) {
+      auto const imported = relocatable ? symbol->isInSymtab() : symbol->isInDynSymtab();
+      if (imported && !symbol->getMangledName().empty()) {
+        corpus.parseImport(symbol);
+      }
+    }
+  }
+
+  // The symbols of a debug file, by name and address, for the stripped library to be described with
+  class typed_symbols {
+    std::map<std::pair<std::string, Offset>, Symbol *> symbols;
+
+  public:
+    explicit typed_symbols(std::vector<Symbol *> const &debug_symbols = {}) {
+      for (auto *symbol : debug_symbols) {
+        symbols.emplace(std::make_pair(symbol->getMangledName(), symbol->getOffset()), symbol);
+      }
+    }
+
+    // The symbol of the debug file, or the symbol itself if there is none
+    Symbol *operator()(Symbol *symbol) const {
+      auto found = symbols.find({symbol->getMangledName(), symbol->getOffset()});
+      return found != symbols.end() ? found->second : symbol;
+    }
+  };
+
+  // The hash of each compilation unit by name. Dyninst names its modules
+  // after the units, so a name that is not unique cannot be looked up.
+  std::map<std::string, std::string> unit_hashes(elf::File const &file) {
+    std::map<std::string, std::string> hashes;
+    std::set<std::string> repeated;
+    for (auto const &unit : dwarf::units(file)) {
+      if (!hashes.emplace(unit.name, unit.hash).second) {
+        repeated.insert(unit.name);
+      }
+    }
+    for (auto const &name : repeated) {
+      hashes.erase(name);
+    }
+    hashes.erase("");
+    return hashes;
+  }
+
+  // The key of a unit in the unit cache: its DWARF, and the symbols of the
+  // interface it has (which visibility or a version script can change alone)
+  std::string unit_key(std::string const &hash, std::vector<Symbol *> const &symbols) {
+    std::vector<std::pair<std::string, int>> names;
+    names.reserve(symbols.size());
+    for (auto *symbol : symbols) {
+      names.emplace_back(symbol->getMangledName(), static_cast<int>(symbol->getType()));
+    }
+    std::sort(names.begin(), names.end());
+    hasher key;
+    key.add(hash);
+    for (auto const &[name, type] : names) {
+      key.add(name);
+      key.add_size(static_cast<std::uint64_t>(type));
+    }
+    return key.hex();
+  }
+
+  // How many handles use each open Symtab
+  std::mutex symtab_lock;
+  std::unordered_map<Symtab *, size_t> symtab_users;
+
+  // What a general Dyninst client loads on top of the types
+  void load_everything(Symtab *symtab) {
+    std::vector<Module *> modules;
+    symtab->getAllModules(modules);
+    for (auto *module : modules) {
+      module->parseLineInformation();
+    }
+    std::vector<Function *> functions;
+    symtab->getAllFunctions(functions);
+    std::vector<localVar *> locals;
+    for (auto *function : functions) {
+      locals.clear();
+      function->getLocalVariables(locals);
+    }
+  }
+}  // namespace
+
+SymtabHandle::SymtabHandle(Symtab *opened) : symtab(opened) {
+  if (symtab) {
+    std::lock_guard<std::mutex> guard(symtab_lock);
+    symtab_users[symtab]++;
+  }
+}
+
+SymtabHandle &SymtabHandle::operator=(SymtabHandle &&other) noexcept {
+  if (this != &other) {
+    reset();
+    symtab = other.symtab;
+    other.symtab = nullptr;
+  }
+  return *this;
+}
+
+void SymtabHandle::reset() {
+  if (!symtab) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(symtab_lock);
+  auto found = symtab_users.find(symtab);
+  if (found != symtab_users.end() && --found->second == 0) {
+    symtab_users.erase(found);
+    Symtab::closeSymtab(symtab);
+  }
+  symtab = nullptr;
+}
+
 Smeagle::Smeagle(std::string _library) : library(std::move(_library)) {}
 
+Smeagle::Smeagle(std::string _library, void const *_image, size_t _image_size)
+    : library(std::move(_library)), image(_image), image_size(_image_size) {}
+
+Symtab *Smeagle::openObject(std::string const &path, void const *data, size_t size,
+                            std::vector<char> &buffer) {
+  // Compressed debug sections are decompressed in parallel here, rather
+  // than one after the other by libdw, and Dyninst opens the copy
+  {
+    SMEAGLE_TRACE_SPAN("load", "decompress", path);
+    PhaseTimer timer(stats, Phase::Decompress);
+    buffer = BufferPool::acquire();
+    try {
+      auto const file = data ? elf::File(data, size, path) : elf::File(path);
+      if (elf::decompress_debug_sections(file, buffer)) {
+        data = buffer.data();
+        size = buffer.size();
+      }
+    } catch (std::runtime_error const &) {
+      // Not an ELF object we can read, Dyninst will say why
+      buffer.clear();
+    }
+    if (buffer.empty()) {
+      BufferPool::release(std::move(buffer));
+      buffer = {};
+    }
+  }
+
+  // Read the object into the Symtab object, cut out early if there's error
+  SMEAGLE_TRACE_SPAN("load", "open", path);
+  PhaseTimer timer(stats, Phase::Open);
+  Symtab *opened = nullptr;
+  // Dyninst does not modify an image that is opened from memory
+  auto const ok = data ? Symtab::openFile(opened, const_cast<void *>(data), size, path)
+                       : Symtab::openFile(opened, path);
+  if (not ok) {
+    throw std::runtime_error{"There was a problem reading from '" + path + "'"};
+  }
+  return opened;
+}
+
+// Open the library with Dyninst, once
+Symtab *Smeagle::open() {
+  if (!obj) {
+    obj = SymtabHandle(openObject(library, image, image_size, inflated));
+  }
+  return obj.get();
+}
+
+std::string const &Smeagle::findDebugFile() {
+  // Objects in memory are archive members, which keep their DWARF
+  if (!debug_file) {
+    debug_file.emplace();
+    if (!image) {
+      try {
+        *debug_file = elf::find_debug_file(elf::File(library), debug_dirs);
+      } catch (std::runtime_error const &) {
+        // Not an ELF object we can read, Dyninst will say why
+      }
+    }
+  }
+  return *debug_file;
+}
+
+Symtab *Smeagle::openDebugInfo() {
+  if (debug_obj) {
+    return debug_obj.get();
+  }
+  auto const &path = findDebugFile();
+  if (path.empty()) {
+    return open();
+  }
+  debug_obj = SymtabHandle(openObject(path, nullptr, 0, debug_inflated));
+  return debug_obj.get();
+}
+
+void Smeagle::close() {
+  obj.reset();
+  debug_obj.reset();
+
+  // Dyninst is done with the decompressed copies
+  for (auto *buffer : {&inflated, &debug_inflated}) {
+    if (buffer->capacity() > 0) {
+      BufferPool::release(std::move(*buffer));
+      *buffer = {};
+    }
+  }
+}
+
 // Determine if the library has exceptions with smeagle
 bool Smeagle::has_exceptions() {
-  Symtab *obj = NULL;
+  SMEAGLE_TRACE_SPAN("load", "has_exceptions", library);
   std::vector<ExceptionBlock *> exceptions;
 
-  // Read the library into the Symtab object, cut out early if there's error
-  if (not Symtab::openFile(obj, library)) {
-    throw std::runtime_error{"There was a problem reading from '" + library + "'"};
-  }
-
   // Parse exceptions
-  obj->getAllExceptions(exceptions);
+  open()->getAllExceptions(exceptions);
   if (exceptions.size() == 0) {
     return false;
   }
   return true;
 }
 
+std::vector<Symbol *> Smeagle::readSymbols(Symtab *symtab) {
+  // Get all functions in the library
+  // Note: looping through this doesn't seem to work
+  SMEAGLE_TRACE_SPAN("load", "symbols", library);
+  PhaseTimer timer(stats, Phase::Symbols);
+  std::vector<Symbol *> symbols;
+  if (not symtab->getAllSymbols(symbols)) {
+    throw std::runtime_error{"There was a problem getting symbols from '" + library + "'"};
+  }
+  return symbols;
+}
+
 // Parse the library with smeagle
 smeagle::Corpus Smeagle::parse() {
+  SMEAGLE_TRACE_SPAN("load", "parse", library);
+  // The chunks share the types their threads have seen in this parse
+  auto const session = TypeCache::newSession();
+  TypeCache::Scope scope(types, session);
+
   // We are going to read functions and symbols
-  Symtab *obj = NULL;
-  std::vector<Symbol *> symbols;
+  Symtab *symtab = open();
+  auto const symbols = readSymbols(symtab);
+  if (stats) stats->add(Counter::Symbols, symbols.size());
+
+  // Create a corpus
+  Corpus corpus(library);
 
-  // Read the library into the Symtab object, cut out early if there's error
-  if (not Symtab::openFile(obj, library)) {
-    throw std::runtime_error{"There was a problem reading from '" + library + "'"};
+  // Find the interface first, which only needs the symbol tables
+  bool const relocatable = symtab->getObjectType() == obj_RelocatableFile;
+  std::vector<Symbol *> interface;
+  bool types_needed = false;
+  for (auto *symbol : symbols) {
+    if (in_interface(symbol, relocatable)) {
+      interface.push_back(symbol);
+      types_needed = types_needed || needs_types(symbol);
+    }
   }
 
-  // Get all functions in the library
-  // Note: looping through this doesn't seem to work
-  if (not obj->getAllSymbols(symbols)) {
-    throw std::runtime_error{"There was a problem getting symbols from '" + library + "'"};
+  // A stripped library is described with the symbols of its debug file
+  Symtab *debug_info = openDebugInfo();
+  typed_symbols const typed(debug_info != symtab ? readSymbols(debug_info)
+                                                 : std::vector<Symbol *>{});
+
+  // Dyninst would load the types on the first lookup anyway, doing it here
+  // keeps it out of the parallel loop and shows it as a phase of its own
+  if (types_needed || profile == LoadProfile::Full) {
+    SMEAGLE_TRACE_SPAN("load", "types", library);
+    PhaseTimer timer(stats, Phase::Types);
+    debug_info->parseTypesNow();
+    if (profile == LoadProfile::Full) {
+      load_everything(debug_info);
+    }
   }
 
-  // Create a corpus
-  Corpus corpus(library);
+  // Symbols are looked at in chunks, which idle threads can steal from a big
+  // library while the small ones are long done. The chunks are merged in
+  // symbol order, so the corpus does not depend on scheduling.
+  constexpr size_t chunk_size = 256;
+  auto const architecture = symtab->getArchitecture();
+  std::vector<std::optional<Corpus>> chunks((interface.size() + chunk_size - 1) / chunk_size);
+  auto parse_chunk = [&](size_t c) {
+    TypeCache::Scope chunk_scope(types, session);
+    Corpus &part = chunks[c].emplace(library);
+    auto const end = std::min(interface.size(), (c + 1) * chunk_size);
+    for (auto i = c * chunk_size; i < end; i++) {
+      if (cancellation && cancellation->stopRequested()) {
+        part.setTruncated();
+        break;
+      }
+      describe(part, interface[i], typed(interface[i]), architecture, stats);
+    }
+  };
+
+  // Isolated, so a thread waiting for our chunks does not pick up another library meanwhile
+  tbb::this_task_arena::isolate([&]() {
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size()), [&](auto const &range) {
+      for (auto c = range.begin(); c != range.end(); c++) {
+        parse_chunk(c);
+      }
+    });
+  });
+  for (auto &part : chunks) {
+    corpus.merge(std::move(*part), "");
+  }
+
+  add_imports(corpus, symtab, relocatable);
+
+  if (stats) stats->add(Counter::CorpusBytes, corpus.retainedSize());
+
+  // Return the corpus for further processing
+  return corpus;
+}
+
+bool Smeagle::stream(std::ostream &out, std::uint64_t memory_budget) {
+  SMEAGLE_TRACE_SPAN("load", "stream", library);
 
-  // Loop through the vector and look at symbols
-  for (auto &symbol : symbols) {
-    // We are interested in symbols in the dynamic symbol table
-    if (symbol->isInDynSymtab()) {
-      // If It's a function, parse the parameters
-      if (symbol->isFunction()) {
-        corpus.parseFunctionABILocation(symbol, obj->getArchitecture());
-
-        // If it's a variable and not a function
-      } else if (symbol->isVariable()) {
-        // Do we have a global variable?
-        if (symbol->getLinkage() == Symbol::SL_GLOBAL) {
-          corpus.parseVariableABILocation(symbol, obj->getArchitecture());
+  // Exports and errors are small, and are written after all the locations
+  Corpus rest(library);
+  CorpusWriter writer(out, library);
+
+  std::map<std::string, std::string> hashes;
+  // Units are named after their module, which is the same after opening again
+  std::set<std::string> written;
+  std::uint64_t floor = 0;
+  auto reopened = true;
+  auto stopped = false;
+  while (reopened && !stopped) {
+    reopened = false;
+    // The session remembers types of this Symtab, which is gone once it is closed
+    TypeCache::Scope scope(types);
+    Symtab *symtab = open();
+    auto const symbols = readSymbols(symtab);
+    if (stats && written.empty()) stats->add(Counter::Symbols, symbols.size());
+
+    Symtab *debug_info = openDebugInfo();
+    typed_symbols const typed(debug_info != symtab ? readSymbols(debug_info)
+                                                   : std::vector<Symbol *>{});
+
+    // Hashing the units only reads their headers, from the (decompressed)
+    // object that has the DWARF, without Dyninst
+    if (unit_cache && written.empty()) {
+      auto const &debug = findDebugFile();
+      auto const &decompressed = debug.empty() ? inflated : debug_inflated;
+      try {
+        if (!decompressed.empty()) {
+          hashes = unit_hashes(elf::File(decompressed.data(), decompressed.size(), library));
+        } else if (!debug.empty()) {
+          hashes = unit_hashes(elf::File(debug));
+        } else if (image) {
+          hashes = unit_hashes(elf::File(image, image_size, library));
+        } else {
+          hashes = unit_hashes(elf::File(library));
+        }
+      } catch (std::runtime_error const &) {
+        // Dyninst can read objects we cannot, which are then parsed whole
+      }
+    }
+
+    bool const relocatable = symtab->getObjectType() == obj_RelocatableFile;
+    std::map<std::string, std::vector<Symbol *>> units;
+    for (auto *symbol : symbols) {
+      if (!in_interface(symbol, relocatable)) continue;
+      auto const *module = typed(symbol)->getModule();
+      auto name = module ? module->fullName() : std::string();
+      if (!written.count(name)) {
+        units[std::move(name)].push_back(symbol);
+      }
+    }
+
+    size_t since_open = 0;
+    for (auto const &[name, unit] : units) {
+      SMEAGLE_TRACE_SPAN("load", "unit", name);
+      Corpus part(library);
+      auto const hash = hashes.find(name);
+      auto const key = hash != hashes.end() ? unit_key(hash->second, unit) : std::string();
+      auto cached = hash != hashes.end() ? unit_cache->find(key) : std::nullopt;
+      if (cached) {
+        for (auto *symbol : unit) {
+          add_export(part, symbol);
+        }
+        PhaseTimer timer(stats, Phase::Serialize);
+        writer.addRendered(*cached);
+      } else {
+        for (auto *symbol : unit) {
+          if (cancellation && cancellation->stopRequested()) {
+            part.setTruncated();
+            break;
+          }
+          describe(part, symbol, typed(symbol), symtab->getArchitecture(), stats);
+        }
+        PhaseTimer timer(stats, Phase::Serialize);
+        RenderedPart rendered;
+        // What was described before the timeout is written, the cancellation
+        // (which stays set once it fired) only ends the parse
+        writer.addLocations(part, nullptr, hash != hashes.end() ? &rendered : nullptr);
+        stopped = part.isTruncated();
+        if (hash != hashes.end() && !stopped) {
+          unit_cache->insert(key, std::move(rendered));
         }
       }
+      part.clearLocations();
+      rest.merge(std::move(part), "");
+      written.insert(name);
+      if (stopped) break;
 
-      // The symbol is something else (we likely want a subset of these?)
+      // What is left after the first unit is what opening the library costs,
+      // and only the growth beyond that can be given back by opening it again
+      auto const rss = memory::current_rss();
+      if (++since_open == 1) floor = rss;
+      if (memory_budget && rss > memory_budget && floor < memory_budget
+          && since_open < units.size()) {
+        close();
+        reopened = true;
+        break;
+      }
+    }
 
-      // else {
-      // std::cout << "symbol_notparsed(" <<  sname << ")" << "\n";
-      //}
+    if (!reopened) {
+      add_imports(rest, symtab, relocatable);
     }
   }
 
-  // Return the corpus for further processing
-  return corpus;
+  writer.finish(rest);
+  if (stats) stats->add(Counter::Errors, writer.writeErrors());
+  return !stopped;
 }
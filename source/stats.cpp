@@ -0,0 +1,255 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/stats.h"
+
+#include "smeagle/memory.h"
+
+#include <time.h>
+
+#include <iomanip>
+#include <iostream>
+
+using namespace smeagle;
+
+namespace {
+  // CPU time consumed by the calling thread
+  Stats::duration thread_cpu_time() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+  }
+
+  double to_ms(Stats::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+  constexpr auto num_phases = static_cast<size_t>(Phase::Count);
+  constexpr auto num_counters = static_cast<size_t>(Counter::Count);
+}  // namespace
+
+char const *Stats::name(Phase phase) {
+  switch (phase) {
+    case Phase::Decompress:
+      return "decompress";
+    case Phase::Open:
+      return "open";
+    case Phase::Symbols:
+      return "symbols";
+    case Phase::Types:
+      return "types";
+    case Phase::Classify:
+      return "classify";
+    case Phase::Params:
+      return "params";
+    case Phase::Allocate:
+      return "allocate";
+    case Phase::Serialize:
+      return "serialize";
+    default:
+      return "unknown";
+  }
+}
+
+char const *Stats::name(Counter counter) {
+  switch (counter) {
+    case Counter::Symbols:
+      return "symbols";
+    case Counter::Functions:
+      return "functions";
+    case Counter::Variables:
+      return "variables";
+    case Counter::Types:
+      return "types";
+    case Counter::Bytes:
+      return "bytes_written";
+    case Counter::CorpusBytes:
+      return "corpus_bytes";
+    case Counter::Errors:
+      return "symbol_errors";
+    default:
+      return "unknown";
+  }
+}
+
+void Stats::addTime(Phase phase, duration wall, duration cpu) {
+  auto &t = phases[static_cast<size_t>(phase)];
+  t.wall_ns.fetch_add(wall.count(), std::memory_order_relaxed);
+  t.cpu_ns.fetch_add(cpu.count(), std::memory_order_relaxed);
+  t.calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stats::addAllocated(Phase phase, std::uint64_t bytes) {
+  phases[static_cast<size_t>(phase)].allocated.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Stats::enableMemory() {
+  memory_enabled = true;
+  memory::enable();
+}
+
+void Stats::addPerf(Phase phase, perf::Sample const &start, perf::Sample const &end) {
+  auto &counts = perf_counts[static_cast<size_t>(phase)];
+  for (size_t i = 0; i < perf::num_events; i++) {
+    if (start.valid[i] && end.valid[i]) {
+      counts[i].fetch_add(end.values[i] - start.values[i], std::memory_order_relaxed);
+      perf_valid[i].store(true, std::memory_order_relaxed);
+    }
+  }
+}
+
+bool Stats::enablePerfCounters() {
+  perf_requested = true;
+  perf_enabled = perf::supported();
+  return perf_enabled;
+}
+
+std::uint64_t Stats::perfCount(Phase phase, perf::Event event) const {
+  return perf_counts[static_cast<size_t>(phase)][static_cast<size_t>(event)].load(
+      std::memory_order_relaxed);
+}
+
+bool Stats::perfValid(perf::Event event) const {
+  return perf_valid[static_cast<size_t>(event)].load(std::memory_order_relaxed);
+}
+
+void Stats::add(Counter counter, std::uint64_t n) {
+  counters[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+}
+
+std::uint64_t Stats::get(Counter counter) const {
+  return counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+std::uint64_t Stats::calls(Phase phase) const {
+  return phases[static_cast<size_t>(phase)].calls.load(std::memory_order_relaxed);
+}
+
+Stats::duration Stats::wallTime(Phase phase) const {
+  return duration{phases[static_cast<size_t>(phase)].wall_ns.load(std::memory_order_relaxed)};
+}
+
+Stats::duration Stats::cpuTime(Phase phase) const {
+  return duration{phases[static_cast<size_t>(phase)].cpu_ns.load(std::memory_order_relaxed)};
+}
+
+std::uint64_t Stats::allocated(Phase phase) const {
+  return phases[static_cast<size_t>(phase)].allocated.load(std::memory_order_relaxed);
+}
+
+void Stats::toText(std::ostream &out) const {
+  auto const flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  out << std::left << std::setw(12) << "phase" << std::right << std::setw(13) << "wall(ms)"
+      << std::setw(14) << "cpu(ms)" << std::setw(11) << "calls" << "\n";
+  for (size_t i = 0; i < num_phases; i++) {
+    auto phase = static_cast<Phase>(i);
+    out << std::left << std::setw(12) << name(phase) << std::right << std::setw(13)
+        << to_ms(wallTime(phase)) << std::setw(14) << to_ms(cpuTime(phase)) << std::setw(11)
+        << calls(phase) << "\n";
+  }
+  out << "\n";
+  for (size_t i = 0; i < num_counters; i++) {
+    auto counter = static_cast<Counter>(i);
+    out << std::left << std::setw(16) << name(counter) << std::right << get(counter) << "\n";
+  }
+
+  if (memory_enabled) {
+    out << "\n" << std::left << std::setw(12) << "phase" << std::right << std::setw(20)
+        << "allocated(bytes)" << "\n";
+    for (size_t i = 0; i < num_phases; i++) {
+      auto phase = static_cast<Phase>(i);
+      out << std::left << std::setw(12) << name(phase) << std::right << std::setw(20)
+          << allocated(phase) << "\n";
+    }
+    out << std::left << std::setw(16) << "peak_rss" << std::right << memory::peak_rss() << "\n";
+  }
+
+  if (perf_enabled) {
+    out << "\n" << std::left << std::setw(12) << "phase" << std::right;
+    for (size_t e = 0; e < perf::num_events; e++) {
+      out << std::setw(16) << perf::name(static_cast<perf::Event>(e));
+    }
+    out << "\n";
+    for (size_t i = 0; i < num_phases; i++) {
+      auto phase = static_cast<Phase>(i);
+      out << std::left << std::setw(12) << name(phase) << std::right;
+      for (size_t e = 0; e < perf::num_events; e++) {
+        auto event = static_cast<perf::Event>(e);
+        if (perfValid(event)) {
+          out << std::setw(16) << perfCount(phase, event);
+        } else {
+          out << std::setw(16) << "n/a";
+        }
+      }
+      out << "\n";
+    }
+  } else if (perf_requested) {
+    out << "\nperf counters are unavailable, only timings were recorded\n";
+  }
+  out.flags(flags);
+}
+
+void Stats::toJson(std::ostream &out) const {
+  auto const flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  out << "{\n \"phases\": {\n";
+  for (size_t i = 0; i < num_phases; i++) {
+    auto phase = static_cast<Phase>(i);
+    auto endcomma = (i + 1 == num_phases) ? "" : ",";
+    out << "  \"" << name(phase) << "\": {\"wall_ms\": " << to_ms(wallTime(phase))
+        << ", \"cpu_ms\": " << to_ms(cpuTime(phase)) << ", \"calls\": " << calls(phase);
+    if (memory_enabled) {
+      out << ", \"allocated_bytes\": " << allocated(phase);
+    }
+    for (size_t e = 0; perf_enabled && e < perf::num_events; e++) {
+      auto event = static_cast<perf::Event>(e);
+      if (perfValid(event)) {
+        out << ", \"" << perf::name(event) << "\": " << perfCount(phase, event);
+      }
+    }
+    out << "}" << endcomma << "\n";
+  }
+  out << " },\n \"counters\": {\n";
+  for (size_t i = 0; i < num_counters; i++) {
+    auto counter = static_cast<Counter>(i);
+    auto endcomma = (i + 1 == num_counters) ? "" : ",";
+    out << "  \"" << name(counter) << "\": " << get(counter) << endcomma << "\n";
+  }
+  out << " }";
+  if (memory_enabled) {
+    out << ",\n \"memory\": {\"peak_rss_bytes\": " << memory::peak_rss()
+        << ", \"current_rss_bytes\": " << memory::current_rss() << "}";
+  }
+  if (perf_requested) {
+    out << ",\n \"perf_counters\": \"" << (perf_enabled ? "enabled" : "unavailable") << "\"";
+  }
+  out << "\n}" << std::endl;
+  out.flags(flags);
+}
+
+PhaseTimer::PhaseTimer(Stats *_stats, Phase _phase) : stats(_stats), phase(_phase) {
+  if (stats) {
+    if (stats->perfEnabled()) {
+      perf_start = perf::read();
+    }
+    if (stats->memoryEnabled()) {
+      allocated_start = memory::thread_allocated();
+    }
+    wall_start = std::chrono::steady_clock::now();
+    cpu_start = thread_cpu_time();
+  }
+}
+
+PhaseTimer::~PhaseTimer() {
+  if (stats) {
+    stats->addTime(phase, std::chrono::steady_clock::now() - wall_start,
+                   thread_cpu_time() - cpu_start);
+    if (stats->perfEnabled()) {
+      stats->addPerf(phase, perf_start, perf::read());
+    }
+    if (stats->memoryEnabled()) {
+      stats->addAllocated(phase, memory::thread_allocated() - allocated_start);
+    }
+  }
+}
@@ -0,0 +1,137 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/trace.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "json.hpp"
+
+using namespace smeagle;
+
+namespace {
+  using clock = std::chrono::steady_clock;
+
+  struct event {
+    char const *category;
+    std::string name;
+    std::string detail;
+    clock::time_point start;
+    clock::duration duration;
+  };
+
+  // Each thread appends to its own buffer, so recording only contends with write()
+  struct thread_buffer {
+    int tid;
+    std::mutex lock;
+    std::vector<event> events;
+  };
+
+  struct registry {
+    std::atomic<bool> enabled{false};
+    clock::time_point epoch = clock::now();
+    std::mutex lock;
+    int next_tid = 1;
+
+    // Buffers are shared so spans from threads that have exited are kept
+    std::vector<std::shared_ptr<thread_buffer>> buffers;
+  };
+
+  registry &get_registry() {
+    static registry r;
+    return r;
+  }
+
+  thread_buffer &local_buffer() {
+    thread_local std::shared_ptr<thread_buffer> buffer = [] {
+      auto &r = get_registry();
+      auto b = std::make_shared<thread_buffer>();
+      std::lock_guard<std::mutex> guard(r.lock);
+      b->tid = r.next_tid++;
+      r.buffers.push_back(b);
+      return b;
+    }();
+    return *buffer;
+  }
+
+  // Chrome trace timestamps are in (fractional) microseconds
+  double to_us(clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+  }
+}  // namespace
+
+void trace::start() { get_registry().enabled.store(true, std::memory_order_release); }
+
+void trace::stop() { get_registry().enabled.store(false, std::memory_order_release); }
+
+bool trace::enabled() { return get_registry().enabled.load(std::memory_order_relaxed); }
+
+void trace::clear() {
+  auto &r = get_registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+  for (auto &b : r.buffers) {
+    std::lock_guard<std::mutex> buffer_guard(b->lock);
+    b->events.clear();
+  }
+}
+
+void trace::write(std::ostream &out) {
+  auto &r = get_registry();
+  auto const pid = getpid();
+  auto const flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+
+  std::lock_guard<std::mutex> guard(r.lock);
+  out << "{\"traceEvents\":[\n";
+  bool first = true;
+  for (auto &b : r.buffers) {
+    std::lock_guard<std::mutex> buffer_guard(b->lock);
+    if (b->events.empty()) continue;
+
+    // Name the thread so workers are easy to tell apart
+    out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+        << ",\"tid\":" << b->tid << ",\"args\":{\"name\":\"worker-" << b->tid << "\"}}";
+    first = false;
+
+    for (auto const &e : b->events) {
+      out << ",\n{\"name\":\"";
+      json::write_escaped(out, e.name);
+      out << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"ts\":" << to_us(e.start - r.epoch)
+          << ",\"dur\":" << to_us(e.duration) << ",\"pid\":" << pid << ",\"tid\":" << b->tid;
+      if (!e.detail.empty()) {
+        out << ",\"args\":{\"detail\":\"";
+        json::write_escaped(out, e.detail);
+        out << "\"}";
+      }
+      out << "}";
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}" << std::endl;
+  out.flags(flags);
+}
+
+trace::Span::Span() : category(nullptr), active(false) {}
+
+trace::Span::Span(char const *_category, std::string _name, std::string _detail)
+    : category(_category),
+      name(std::move(_name)),
+      detail(std::move(_detail)),
+      start(clock::now()),
+      active(enabled()) {}
+
+trace::Span::~Span() {
+  if (!active) return;
+  auto const end = clock::now();
+  auto &buffer = local_buffer();
+  std::lock_guard<std::mutex> guard(buffer.lock);
+  buffer.events.push_back({category, std::move(name), std::move(detail), start, end - start});
+}
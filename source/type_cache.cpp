@@ -0,0 +1,76 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/type_cache.h"
+
+#include <mutex>
+
+using namespace smeagle;
+
+namespace {
+  thread_local TypeCache::Scope *innermost = nullptr;
+  std::atomic<std::uint64_t> last_session{0};
+
+  // The types this thread has seen in one session. Another session (such as
+  // a task of another parse run by this thread) starts it over.
+  struct seen_types {
+    std::uint64_t session = 0;
+    std::unordered_map<void const *, TypeCache::entry> classes;
+  };
+  thread_local seen_types seen;
+
+  std::unordered_map<void const *, TypeCache::entry> &seen_in(std::uint64_t session) {
+    if (seen.session != session) {
+      seen.classes.clear();
+      seen.session = session;
+    }
+    return seen.classes;
+  }
+}  // namespace
+
+std::optional<TypeCache::entry> TypeCache::find(std::string const &key) const {
+  std::shared_lock<std::shared_mutex> guard(lock);
+  if (auto found = classes.find(key); found != classes.end()) {
+    hit_count++;
+    return found->second;
+  }
+  miss_count++;
+  return std::nullopt;
+}
+
+void TypeCache::insert(std::string const &key, entry value) {
+  std::unique_lock<std::shared_mutex> guard(lock);
+  classes.emplace(key, value);
+}
+
+size_t TypeCache::size() const {
+  std::shared_lock<std::shared_mutex> guard(lock);
+  return classes.size();
+}
+
+TypeCache *TypeCache::active() { return innermost ? innermost->getCache() : nullptr; }
+
+std::uint64_t TypeCache::newSession() { return ++last_session; }
+
+TypeCache::Scope::Scope(TypeCache *_cache, std::uint64_t _session)
+    : cache(_cache), previous(innermost), session(_session ? _session : newSession()) {
+  innermost = this;
+}
+
+TypeCache::Scope::~Scope() { innermost = previous; }
+
+TypeCache::Scope *TypeCache::Scope::current() { return innermost; }
+
+std::optional<TypeCache::entry> TypeCache::Scope::recall(void const *type) const {
+  auto const &classes = seen_in(session);
+  if (auto found = classes.find(type); found != classes.end()) {
+    return found->second;
+  }
+  return std::nullopt;
+}
+
+void TypeCache::Scope::remember(void const *type, entry value) {
+  seen_in(session).emplace(type, value);
+}
@@ -0,0 +1,71 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/unit_cache.h"
+
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+#include "json.hpp"
+
+using namespace smeagle;
+
+std::optional<RenderedPart> UnitCache::find(std::string const &hash) {
+  if (auto found = units.find(hash); found != units.end()) {
+    hit_count++;
+    used.insert(hash);
+    return found->second;
+  }
+  miss_count++;
+  return std::nullopt;
+}
+
+void UnitCache::insert(std::string const &hash, RenderedPart part) {
+  units[hash] = std::move(part);
+  used.insert(hash);
+}
+
+void UnitCache::load(std::istream &in) {
+  std::string const text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+  auto const document = json::parse(text);
+  for (auto const &[hash, unit] : document.at("units").object) {
+    RenderedPart part;
+    for (auto const &location : unit.at("locations").array) {
+      part.locations.push_back(location.string);
+    }
+    for (auto const &error : unit.at("errors").array) {
+      part.errors.push_back({error.at("symbol").string, error.at("reason").string});
+    }
+    units[hash] = std::move(part);
+  }
+}
+
+void UnitCache::save(std::ostream &out) const {
+  out << "{\n"
+      << " \"units\": {";
+  auto first = true;
+  for (auto const &hash : used) {
+    auto const &unit = units.at(hash);
+    out << (first ? "\n" : ",\n") << "  \"" << hash << "\": {\n"
+        << "   \"locations\": [";
+    for (auto const &location : unit.locations) {
+      out << (&location == &unit.locations.front() ? "\n    " : ",\n    ");
+      json::write_string(out, location);
+    }
+    out << "],\n"
+        << "   \"errors\": [";
+    for (auto const &e : unit.errors) {
+      out << (&e == &unit.errors.front() ? "\n    " : ",\n    ") << "{\"symbol\": ";
+      json::write_string(out, e.symbol);
+      out << ", \"reason\": ";
+      json::write_string(out, e.reason);
+      out << "}";
+    }
+    out << "]}";
+    first = false;
+  }
+  out << "\n }\n}" << std::endl;
+}
@@ -0,0 +1,226 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include "smeagle/watch.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include "mapped_file.hpp"
+#include "smeagle/elf.h"
+#include "smeagle/smeagle.h"
+
+using namespace smeagle;
+namespace fs = std::filesystem;
+
+namespace {
+  constexpr std::uint32_t directory_events = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM
+                                             | IN_MOVED_TO | IN_DELETE | IN_ONLYDIR
+                                             | IN_DONT_FOLLOW;
+}  // namespace
+
+// The last version of a library that was parsed
+struct Watcher::version {
+  std::vector<char> bytes;
+  Smeagle smeagle;
+  Corpus corpus;
+
+  version(std::string const &path, std::vector<char> _bytes)
+      : bytes(std::move(_bytes)),
+        smeagle(path, bytes.data(), bytes.size()),
+        corpus(smeagle.parse()) {}
+  ~version() { smeagle.close(); }
+};
+
+Watcher::Watcher(std::string _root, std::chrono::milliseconds _debounce)
+    : root(std::move(_root)), debounce(_debounce) {
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd < 0 || pipe2(wake_fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+    auto const reason = std::strerror(errno);
+    if (inotify_fd >= 0) close(inotify_fd);
+    throw std::runtime_error{std::string{"Cannot watch for changes: "} + reason};
+  }
+
+  // Watch first, so nothing written while the baseline is parsed is missed
+  std::vector<std::string> libraries;
+  try {
+    watchTree(root, libraries);
+  } catch (...) {
+    close(inotify_fd);
+    close(wake_fds[0]);
+    close(wake_fds[1]);
+    throw;
+  }
+  std::sort(libraries.begin(), libraries.end());
+  for (auto const &library : libraries) {
+    if (auto event = analyze(library)) {
+      initial.push_back(std::move(*event));
+    }
+  }
+}
+
+Watcher::~Watcher() {
+  versions.clear();
+  close(inotify_fd);
+  close(wake_fds[0]);
+  close(wake_fds[1]);
+}
+
+void Watcher::stop() {
+  char const byte = 0;
+  [[maybe_unused]] auto n = write(wake_fds[1], &byte, 1);
+}
+
+void Watcher::watchTree(std::string const &directory, std::vector<std::string> &libraries) {
+  auto const wd = inotify_add_watch(inotify_fd, directory.c_str(), directory_events);
+  if (wd < 0) {
+    // A directory that is already gone is not an error, a root we cannot watch is
+    if (directory == root) {
+      throw std::runtime_error{"Cannot watch '" + directory + "': " + std::strerror(errno)};
+    }
+    return;
+  }
+  directories[wd] = directory;
+
+  std::error_code ec;
+  for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+    auto const status = it->symlink_status(ec);
+    auto const path = directory + "/" + it->path().filename().string();
+    if (fs::is_directory(status)) {
+      watchTree(path, libraries);
+    } else if (fs::is_regular_file(status) && elf::has_magic(path)) {
+      libraries.push_back(path);
+    }
+  }
+}
+
+void Watcher::readEvents() {
+  alignas(inotify_event) char buffer[64 * 1024];
+  auto const now = std::chrono::steady_clock::now();
+  while (true) {
+    auto const n = read(inotify_fd, buffer, sizeof buffer);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) continue;
+      return;
+    }
+    for (char const *p = buffer; p < buffer + n;) {
+      auto const *event = reinterpret_cast<inotify_event const *>(p);
+      p += sizeof(inotify_event) + event->len;
+
+      // Events were lost, so look at everything again
+      if (event->mask & IN_Q_OVERFLOW) {
+        std::vector<std::string> libraries;
+        watchTree(root, libraries);
+        for (auto const &[library, last] : versions) pending[library] = now;
+        for (auto const &library : libraries) pending[library] = now;
+        continue;
+      }
+      if (event->mask & IN_IGNORED) {
+        directories.erase(event->wd);
+        continue;
+      }
+      auto const directory = directories.find(event->wd);
+      if (directory == directories.end() || event->len == 0) continue;
+      auto const path = directory->second + "/" + event->name;
+
+      // A new directory may already have libraries in it
+      if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+        std::vector<std::string> libraries;
+        watchTree(path, libraries);
+        for (auto const &library : libraries) pending[library] = now;
+      } else if (!(event->mask & IN_ISDIR)) {
+        pending[path] = now;
+      }
+    }
+  }
+}
+
+std::optional<watch_event> Watcher::analyze(std::string const &path) {
+  auto known = versions.find(path);
+  std::error_code ec;
+  auto const status = fs::symlink_status(path, ec);
+  if (ec || !fs::is_regular_file(status) || !elf::has_magic(path)) {
+    if (known == versions.end()) return std::nullopt;
+    versions.erase(known);
+    return watch_event{path, watch_event::kind::removed, {}, {}};
+  }
+
+  try {
+    auto bytes = read_file(path);
+    if (!elf::File(bytes.data(), bytes.size(), path).is_shared_library()) {
+      return std::nullopt;
+    }
+    auto next = std::make_unique<version>(path, std::move(bytes));
+    watch_event event{path, watch_event::kind::added, {}, {}};
+    if (known != versions.end()) {
+      event.what = watch_event::kind::changed;
+      event.diff = diff(known->second->corpus, next->corpus);
+      known->second = std::move(next);
+    } else {
+      versions.emplace(path, std::move(next));
+    }
+    return event;
+  } catch (std::exception const &e) {
+    // The last version that parsed is kept, to compare the next one with
+    return watch_event{path, watch_event::kind::failed, {}, e.what()};
+  }
+}
+
+std::vector<watch_event> Watcher::wait(std::chrono::milliseconds timeout) {
+  using clock = std::chrono::steady_clock;
+  auto const until = timeout.count() < 0 ? clock::time_point::max() : clock::now() + timeout;
+
+  while (true) {
+    // Libraries that were left alone long enough are parsed again
+    auto const now = clock::now();
+    std::vector<std::string> ready;
+    auto next_ready = clock::time_point::max();
+    for (auto const &[path, last] : pending) {
+      if (now - last >= debounce) {
+        ready.push_back(path);
+      } else {
+        next_ready = std::min(next_ready, last + debounce);
+      }
+    }
+    std::vector<watch_event> events;
+    for (auto const &path : ready) {
+      pending.erase(path);
+      if (auto event = analyze(path)) {
+        events.push_back(std::move(*event));
+      }
+    }
+    if (!events.empty()) return events;
+    if (pending.empty() && now >= until) return {};
+
+    // Sleep until the next library is ready, something is written, or the time is up
+    auto const wake = pending.empty() ? until : next_ready;
+    int wait_ms = -1;
+    if (wake != clock::time_point::max()) {
+      auto const left = std::chrono::ceil<std::chrono::milliseconds>(wake - clock::now());
+      wait_ms = static_cast<int>(std::clamp<std::int64_t>(left.count(), 0, 60 * 60 * 1000));
+    }
+    pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {wake_fds[0], POLLIN, 0}};
+    if (poll(fds, 2, wait_ms) < 0 && errno != EINTR) {
+      throw std::runtime_error{std::string{"Cannot wait for changes: "} + std::strerror(errno)};
+    }
+    if (fds[1].revents & POLLIN) {
+      char drain[64];
+      while (read(wake_fds[0], drain, sizeof drain) > 0) {
+      }
+      return {};
+    }
+    if (fds[0].revents & POLLIN) {
+      readEvents();
+    }
+  }
+}
@@ -0,0 +1,91 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+// Replacements for the global allocation functions, which count what each
+// thread allocates for --stats --memory. They are part of the executable
+// rather than the library, so programs that embed Smeagle keep their own.
+
+#include <smeagle/memory.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+  void *allocate(std::size_t size) {
+    for (;;) {
+      if (void *p = std::malloc(size ? size : 1)) {
+        smeagle::memory::note_allocation(size);
+        return p;
+      }
+      auto handler = std::get_new_handler();
+      if (!handler) throw std::bad_alloc{};
+      handler();
+    }
+  }
+
+  void *allocate_aligned(std::size_t size, std::align_val_t alignment) {
+    auto const align = static_cast<std::size_t>(alignment);
+    for (;;) {
+      void *p = nullptr;
+      if (posix_memalign(&p, align < sizeof(void *) ? sizeof(void *) : align, size ? size : 1)
+          == 0) {
+        smeagle::memory::note_allocation(size);
+        return p;
+      }
+      auto handler = std::get_new_handler();
+      if (!handler) throw std::bad_alloc{};
+      handler();
+    }
+  }
+}  // namespace
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+
+void *operator new(std::size_t size, std::nothrow_t const &) noexcept {
+  try {
+    return allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new[](std::size_t size, std::nothrow_t const &) noexcept {
+  try {
+    return allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void *operator new(std::size_t size, std::align_val_t al) { return allocate_aligned(size, al); }
+void *operator new[](std::size_t size, std::align_val_t al) { return allocate_aligned(size, al); }
+
+void *operator new(std::size_t size, std::align_val_t al, std::nothrow_t const &) noexcept {
+  try {
+    return allocate_aligned(size, al);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new[](std::size_t size, std::align_val_t al, std::nothrow_t const &) noexcept {
+  try {
+    return allocate_aligned(size, al);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::nothrow_t const &) noexcept { std::free(p); }
+void operator delete[](void *p, std::nothrow_t const &) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t, std::nothrow_t const &) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t, std::nothrow_t const &) noexcept { std::free(p); }
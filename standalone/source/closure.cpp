@@ -0,0 +1,85 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <smeagle/bindings.h>
+#include <smeagle/closure.h>
+#include <smeagle/stats.h>
+
+#include <cxxopts.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "commands.hpp"
+
+int closure(int argc, char** argv) {
+  cxxopts::Options options("Smeagle closure",
+                           "Parse a binary and every shared library that it loads.");
+  options.positional_help("<binary>");
+
+  std::string binary;
+
+  // clang-format off
+  options.add_options()
+    ("h,help", "Show help")
+    ("b,binary", "Executable or library to start from", cxxopts::value(binary))
+    ("dependencies", "Only resolve the dependency graph, do not parse")
+    ("bindings", "Report where each imported symbol binds to, instead of the corpora")
+    ("problems", "With --bindings, only report the bindings that have a problem")
+    ("stats", "Report phase timings and counters to stderr (text or json)",
+     cxxopts::value<std::string>()->implicit_value("text"))
+  ;
+  // clang-format on
+  options.parse_positional({"binary"});
+
+  auto result = options.parse(argc, argv);
+
+  if (result["help"].as<bool>() || binary.empty()) {
+    std::cout << options.help() << std::endl;
+    return binary.empty() && !result["help"].as<bool>();
+  }
+
+  smeagle::Closure closure(smeagle::resolveDependencies(binary));
+  auto const& graph = closure.getGraph();
+  for (auto const& [library, names] : graph.missing) {
+    for (auto const& name : names) {
+      std::cerr << library << ": cannot find " << name << "\n";
+    }
+  }
+
+  if (!result["dependencies"].as<bool>()) {
+    smeagle::Stats stats;
+    auto const want_stats = result["stats"].count() > 0;
+    closure.parse(want_stats ? &stats : nullptr);
+    for (auto const& [library, error] : closure.getErrors()) {
+      std::cerr << library << ": " << error << "\n";
+    }
+    if (want_stats) {
+      auto const& types = closure.getTypeCache();
+      std::cerr << "type cache: " << types.size() << " types, " << types.hits() << " hits, "
+                << types.misses() << " misses\n";
+      if (result["stats"].as<std::string>() == "json") {
+        stats.toJson(std::cerr);
+      } else {
+        stats.toText(std::cerr);
+      }
+    }
+  }
+  if (result["bindings"].as<bool>() && !result["dependencies"].as<bool>()) {
+    // The corpora in load order are the lookup scope of the dynamic linker
+    std::vector<smeagle::Corpus const*> scope;
+    for (auto const& library : graph.libraries) {
+      if (auto found = closure.getCorpora().find(library); found != closure.getCorpora().end()) {
+        scope.push_back(&found->second);
+      }
+    }
+    smeagle::SymbolResolver resolver(scope);
+    smeagle::SymbolResolver::toJson(resolver.resolveAll(), std::cout,
+                                    result["problems"].as<bool>());
+  } else {
+    closure.toJson(std::cout);
+  }
+  return graph.missing.empty() && closure.getErrors().empty() ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#pragma once
+
+// Subcommands of the standalone client, each gets the arguments after its name
+int closure(int argc, char** argv);
+int layer(int argc, char** argv);
+int merge(int argc, char** argv);
+int scan(int argc, char** argv);
+int serve(int argc, char** argv);
+int watch(int argc, char** argv);
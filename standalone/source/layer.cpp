@@ -0,0 +1,53 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <smeagle/layer.h>
+#include <smeagle/stats.h>
+
+#include <cxxopts.hpp>
+#include <iostream>
+#include <string>
+
+#include "commands.hpp"
+
+int layer(int argc, char** argv) {
+  cxxopts::Options options("Smeagle layer",
+                           "Parse the shared libraries in a container image layer, in memory.");
+  options.positional_help("<layer.tar[.gz] or ->");
+
+  std::string path;
+
+  // clang-format off
+  options.add_options()
+    ("h,help", "Show help")
+    ("f,file", "Layer tarball, optionally gzip compressed (- for stdin)", cxxopts::value(path))
+    ("stats", "Report phase timings and counters to stderr (text or json)",
+     cxxopts::value<std::string>()->implicit_value("text"))
+  ;
+  // clang-format on
+  options.parse_positional({"file"});
+
+  auto result = options.parse(argc, argv);
+
+  if (result["help"].as<bool>() || path.empty()) {
+    std::cout << options.help() << std::endl;
+    return path.empty() && !result["help"].as<bool>();
+  }
+
+  smeagle::Stats stats;
+  auto const want_stats = result["stats"].count() > 0;
+  smeagle::LayerCorpus corpus(path);
+  corpus.parse(want_stats ? &stats : nullptr);
+  corpus.toJson(std::cout);
+
+  if (want_stats) {
+    if (result["stats"].as<std::string>() == "json") {
+      stats.toJson(std::cerr);
+    } else {
+      stats.toText(std::cerr);
+    }
+  }
+  return 0;
+}
@@ -3,17 +3,50 @@
 //
 // SPDX-License-Identifier: (Apache-2.0 OR MIT)
 
+#include <smeagle/archive.h>
 #include <smeagle/corpora.h>
 #include <smeagle/smeagle.h>
+#include <smeagle/stats.h>
+#include <smeagle/trace.h>
+#include <smeagle/unit_cache.h>
 #include <smeagle/version.h>
 
+#include <chrono>
 #include <cxxopts.hpp>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
+
+#include "commands.hpp"
 
 auto main(int argc, char** argv) -> int {
+  // Corpora are large and only written through iostreams, which need not wait for stdio
+  std::ios::sync_with_stdio(false);
+
+  // Subcommands have their own options
+  if (argc > 1 && std::string(argv[1]) == "serve") {
+    return serve(argc - 1, argv + 1);
+  }
+  if (argc > 1 && std::string(argv[1]) == "closure") {
+    return closure(argc - 1, argv + 1);
+  }
+  if (argc > 1 && std::string(argv[1]) == "layer") {
+    return layer(argc - 1, argv + 1);
+  }
+  if (argc > 1 && std::string(argv[1]) == "merge") {
+    return merge(argc - 1, argv + 1);
+  }
+  if (argc > 1 && std::string(argv[1]) == "scan") {
+    return scan(argc - 1, argv + 1);
+  }
+  if (argc > 1 && std::string(argv[1]) == "watch") {
+    return watch(argc - 1, argv + 1);
+  }
+
   cxxopts::Options options(*argv, "Extract library metadata, the precious.");
+  options.positional_help("[closure|layer|merge|scan|serve|watch]");
 
   std::string library;
 
@@ -23,6 +56,21 @@ auto main(int argc, char** argv) -> int {
     ("v,version", "Print the current version number")
     ("l,library", "Library to inspect", cxxopts::value(library))
     ("has-exceptions", "Show if a library has exceptions")
+    ("stats", "Report phase timings and counters to stderr (text or json)",
+     cxxopts::value<std::string>()->implicit_value("text"))
+    ("memory", "Add peak RSS and bytes allocated per phase to --stats")
+    ("perf-counters", "Add cycles, instructions, cache misses and page faults to --stats")
+    ("trace", "Write a Chrome trace-event timeline to this file", cxxopts::value<std::string>())
+    ("load-profile", "Debug information to load: minimal (what Smeagle needs) or full",
+     cxxopts::value<std::string>()->default_value("minimal"))
+    ("memory-budget", "Parse a compilation unit at a time, writing as it goes, within this many MiB",
+     cxxopts::value<size_t>())
+    ("debug-dir", "Look for the debug file of a stripped library here (as well as /usr/lib/debug)",
+     cxxopts::value<std::vector<std::string>>())
+    ("unit-cache", "Reuse the compilation units that did not change since the last run, kept in this file",
+     cxxopts::value<std::string>())
+    ("timeout", "Stop after this many seconds, writing a corpus marked as truncated",
+     cxxopts::value<double>())
   ;
 
   // clang-format on
@@ -47,12 +95,133 @@ auto main(int argc, char** argv) -> int {
 
   smeagle::Smeagle smeagle(library);
 
-  if (result["has-exceptions"].as<bool>()) {
-    smeagle.has_exceptions();
-    return 0;
+  auto const profile_name = result["load-profile"].as<std::string>();
+  auto profile = smeagle::LoadProfile::Minimal;
+  if (profile_name == "full") {
+    profile = smeagle::LoadProfile::Full;
+  } else if (profile_name != "minimal") {
+    std::cerr << "Unknown load profile '" << profile_name << "' (expected minimal or full)\n";
+    return 1;
+  }
+  smeagle.setLoadProfile(profile);
+
+  std::vector<std::string> debug_dirs;
+  if (result["debug-dir"].count() > 0) {
+    debug_dirs = result["debug-dir"].as<std::vector<std::string>>();
+  }
+  debug_dirs.push_back("/usr/lib/debug");
+  smeagle.setDebugDirectories(debug_dirs);
+
+  smeagle::CancellationToken cancellation;
+  auto const timeout = result["timeout"].count() > 0;
+  if (timeout) {
+    auto const seconds = std::chrono::duration<double>(result["timeout"].as<double>());
+    cancellation.setTimeout(std::chrono::duration_cast<std::chrono::milliseconds>(seconds));
+    smeagle.setCancellation(&cancellation);
+  }
+
+  if (result["trace"].count() > 0) {
+    if (!smeagle::trace::available) {
+      std::cerr << "Smeagle was built without SMEAGLE_ENABLE_TRACING, the trace will be empty.\n";
+    }
+    smeagle::trace::start();
+  }
+
+  smeagle::Stats stats;
+  auto const want_stats = result["stats"].count() > 0;
+  if (want_stats) {
+    smeagle.setStats(&stats);
+    if (result["memory"].as<bool>()) {
+      stats.enableMemory();
+    }
+    if (result["perf-counters"].as<bool>() && !stats.enablePerfCounters()) {
+      std::cerr << "perf_event_open is not available, reporting timings only.\n";
+    }
+  }
+
+  // Static archives get one corpus for all of their members
+  if (smeagle::ar::has_magic(library)) {
+    // Members are parsed whole and in parallel, so there is nothing to stream
+    if (result["memory-budget"].count() > 0 || result["unit-cache"].count() > 0) {
+      std::cerr << "--memory-budget and --unit-cache are not supported for static archives\n";
+      return 1;
+    }
+    smeagle::ArchiveCorpus archive(library);
+    archive.setLoadProfile(profile);
+    archive.setDebugDirectories(debug_dirs);
+    if (timeout) {
+      archive.setCancellation(&cancellation);
+    }
+    auto const& corpus = archive.parse(want_stats ? &stats : nullptr);
+    for (auto const& [member, error] : archive.getErrors()) {
+      std::cerr << library << "(" << member << "): " << error << "\n";
+    }
+    corpus.toJson(std::cout, want_stats ? &stats : nullptr);
+    if (!corpus.getErrors().empty()) {
+      std::cerr << corpus.getErrors().size() << " symbols could not be parsed, see \"errors\"\n";
+    }
+    if (corpus.isTruncated()) {
+      std::cerr << "Timed out, the corpus is truncated\n";
+    }
+  } else {
+    if (result["has-exceptions"].as<bool>()) {
+      std::cout << (smeagle.has_exceptions() ? "true" : "false") << "\n";
+    } else if (result["memory-budget"].count() > 0 || result["unit-cache"].count() > 0) {
+      std::uint64_t budget = 0;
+      if (result["memory-budget"].count() > 0) {
+        budget = static_cast<std::uint64_t>(result["memory-budget"].as<size_t>()) << 20;
+      }
+
+      // A missing cache is a first run, an unreadable one is started over
+      smeagle::UnitCache units;
+      if (result["unit-cache"].count() > 0) {
+        std::ifstream in(result["unit-cache"].as<std::string>());
+        if (in) {
+          try {
+            units.load(in);
+          } catch (std::runtime_error const& e) {
+            std::cerr << "Ignoring the unit cache: " << e.what() << "\n";
+          }
+        }
+        smeagle.setUnitCache(&units);
+      }
+
+      if (!smeagle.stream(std::cout, budget)) {
+        std::cerr << "Timed out, the corpus is truncated\n";
+      }
+
+      if (result["unit-cache"].count() > 0) {
+        std::ofstream out(result["unit-cache"].as<std::string>());
+        units.save(out);
+        std::cerr << units.hits() << " of " << units.hits() + units.misses()
+                  << " compilation units reused\n";
+      }
+    } else {
+      smeagle::Corpus corpus = smeagle.parse();
+      corpus.toJson(std::cout, want_stats ? &stats : nullptr);
+      if (!corpus.getErrors().empty()) {
+        std::cerr << corpus.getErrors().size()
+                  << " symbols could not be parsed, see \"errors\"\n";
+      }
+      if (corpus.isTruncated()) {
+        std::cerr << "Timed out, the corpus is truncated\n";
+      }
+    }
+  }
+
+  if (want_stats) {
+    if (result["stats"].as<std::string>() == "json") {
+      stats.toJson(std::cerr);
+    } else {
+      stats.toText(std::cerr);
+    }
+  }
+
+  if (result["trace"].count() > 0) {
+    smeagle::trace::stop();
+    std::ofstream out(result["trace"].as<std::string>());
+    smeagle::trace::write(out);
   }
-  smeagle::Corpus corpus = smeagle.parse();
-  corpus.toJson();
 
   return 0;
 }
@@ -0,0 +1,94 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <smeagle/scan.h>
+
+#include <cxxopts.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "commands.hpp"
+
+namespace fs = std::filesystem;
+
+int merge(int argc, char** argv) {
+  cxxopts::Options options("Smeagle merge",
+                           "Combine the shards of a scan into the result of a single scan.");
+  options.positional_help("<shard-directory>...");
+
+  std::vector<std::string> directories;
+  std::string output_dir;
+
+  // clang-format off
+  options.add_options()
+    ("h,help", "Show help")
+    ("o,output-dir", "Write the merged corpora and index.json here", cxxopts::value(output_dir))
+    ("directories", "Output directories of the shards", cxxopts::value(directories))
+  ;
+  // clang-format on
+  options.parse_positional({"directories"});
+
+  auto result = options.parse(argc, argv);
+
+  if (result["help"].as<bool>() || directories.empty() || output_dir.empty()) {
+    std::cout << options.help() << std::endl;
+    return !result["help"].as<bool>();
+  }
+
+  // Find the index of every shard, which must all be of the same scan
+  std::regex const pattern("index-([0-9]+)-of-([0-9]+)\\.json");
+  std::map<size_t, fs::path> shards;
+  size_t count = 0;
+  for (auto const& directory : directories) {
+    for (auto const& entry : fs::directory_iterator(directory)) {
+      std::smatch match;
+      auto const name = entry.path().filename().string();
+      if (!std::regex_match(name, match, pattern)) continue;
+      auto const index = std::stoul(match[1]);
+      auto const of = std::stoul(match[2]);
+      if (count != 0 && of != count) {
+        std::cerr << entry.path().string() << " is a shard of " << of << ", not " << count << "\n";
+        return 1;
+      }
+      count = of;
+      if (!shards.emplace(index, entry.path()).second) {
+        std::cerr << "Shard " << index << " was found twice\n";
+        return 1;
+      }
+    }
+  }
+  if (count == 0 || shards.size() != count) {
+    std::cerr << "Found " << shards.size() << " of " << count << " shards\n";
+    return 1;
+  }
+
+  fs::create_directories(output_dir);
+  smeagle::ScanResult merged;
+  std::map<std::string, std::string> errors;
+  for (auto const& [index, path] : shards) {
+    std::ifstream in(path);
+    auto const part = smeagle::readIndex(in, &errors);
+
+    // Corpora that are not in the output directory yet are copied over
+    for (auto const& library : part.libraries) {
+      auto const corpus = path.parent_path() / part.corpusName(library);
+      auto const target = fs::path(output_dir) / part.corpusName(library);
+      if (fs::exists(corpus) && !fs::equivalent(corpus.parent_path(), output_dir)) {
+        fs::copy_file(corpus, target, fs::copy_options::overwrite_existing);
+      }
+    }
+    merged.merge(part);
+  }
+
+  std::ofstream index(output_dir + "/index.json");
+  merged.toJson(index, errors, true);
+  std::cerr << merged.libraries.size() << " libraries from " << count << " shards\n";
+  return errors.empty() ? 0 : 1;
+}
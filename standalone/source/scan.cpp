@@ -0,0 +1,128 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <smeagle/batch.h>
+#include <smeagle/scan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cxxopts.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "commands.hpp"
+
+int scan(int argc, char** argv) {
+  cxxopts::Options options("Smeagle scan",
+                           "Find the distinct shared libraries in a tree, and parse each once.");
+  options.positional_help("<directory>");
+
+  std::string root;
+  std::string output_dir;
+  size_t workers = 0;
+  size_t worker_memory = 0;
+  size_t memory_budget = 0;
+  double timeout = 0;
+  bool resume = false;
+  std::string shard;
+  std::vector<std::string> debug_dirs;
+
+  // clang-format off
+  options.add_options()
+    ("h,help", "Show help")
+    ("d,directory", "Directory to scan", cxxopts::value(root))
+    ("o,output-dir", "Parse each distinct library, writing its corpus and an index.json here",
+     cxxopts::value(output_dir))
+    ("w,workers", "Parse in this many worker processes, so a crash only loses one library",
+     cxxopts::value(workers)->default_value("0"))
+    ("worker-memory", "Replace a worker once it uses more than this many MiB",
+     cxxopts::value(worker_memory)->default_value("0"))
+    ("memory-budget", "Parse libraries a compilation unit at a time, within this many MiB",
+     cxxopts::value(memory_budget)->default_value("0"))
+    ("debug-dir", "Look for the debug files of stripped libraries here (as well as /usr/lib/debug)",
+     cxxopts::value(debug_dirs))
+    ("timeout", "Stop parsing a library after this many seconds, keeping a truncated corpus",
+     cxxopts::value(timeout)->default_value("0"))
+    ("resume", "Continue an interrupted scan from the journal in the output directory",
+     cxxopts::value(resume))
+    ("shard", "Only parse shard i of N (as i/N, from 0), see smeagle merge",
+     cxxopts::value(shard))
+  ;
+  // clang-format on
+  options.parse_positional({"directory"});
+
+  auto result = options.parse(argc, argv);
+
+  if (result["help"].as<bool>() || root.empty()) {
+    std::cout << options.help() << std::endl;
+    return root.empty() && !result["help"].as<bool>();
+  }
+
+  size_t shard_index = 0, shard_count = 0;
+  if (!shard.empty()) {
+    auto const slash = shard.find('/');
+    try {
+      shard_index = std::stoul(shard.substr(0, slash));
+      shard_count = slash == std::string::npos ? 0 : std::stoul(shard.substr(slash + 1));
+    } catch (std::exception const&) {
+    }
+    if (shard_count == 0 || shard_index >= shard_count || output_dir.empty()) {
+      std::cerr << "--shard needs an output directory and i/N with 0 <= i < N\n";
+      return 1;
+    }
+  }
+
+  auto found = smeagle::scan(root);
+  std::cerr << found.canonical.size() << " libraries, " << found.libraries.size()
+            << " distinct\n";
+
+  // Shards share the output directory, so their index and journal are named after them
+  std::string suffix;
+  if (shard_count > 0) {
+    found = found.shard(shard_index, shard_count);
+    suffix = "-" + std::to_string(shard_index) + "-of-" + std::to_string(shard_count);
+    std::cerr << "Shard " << shard << " has " << found.libraries.size() << " libraries\n";
+  }
+
+  // Without an output directory, only report the mapping
+  if (output_dir.empty()) {
+    found.toJson(std::cout);
+    return 0;
+  }
+
+  std::filesystem::create_directories(output_dir);
+  std::vector<smeagle::batch_item> items;
+  for (auto const& library : found.libraries) {
+    items.push_back({library, output_dir + "/" + found.corpusName(library)});
+  }
+
+  smeagle::batch_options batch;
+  batch.workers = workers;
+  batch.worker_memory_limit = static_cast<std::uint64_t>(worker_memory) << 20;
+  batch.memory_budget = static_cast<std::uint64_t>(memory_budget) << 20;
+  batch.timeout = std::chrono::milliseconds(static_cast<long long>(timeout * 1000));
+  batch.debug_dirs = debug_dirs;
+  batch.debug_dirs.push_back("/usr/lib/debug");
+  batch.journal = output_dir + "/journal" + suffix + ".tsv";
+  batch.resume = resume;
+
+  std::map<std::string, std::string> errors;
+  for (auto const& outcome : smeagle::runBatch(items, batch)) {
+    if (!outcome.ok) {
+      std::cerr << outcome.library << ": " << outcome.error << "\n";
+      errors[outcome.library] = outcome.error;
+    } else if (outcome.truncated) {
+      std::cerr << outcome.library << ": timed out, the corpus is truncated\n";
+    }
+  }
+
+  std::ofstream index(output_dir + "/index" + suffix + ".json");
+  found.toJson(index, errors, true);
+  return errors.empty() ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <smeagle/server.h>
+
+#include <csignal>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <string>
+
+#include "commands.hpp"
+
+namespace {
+  smeagle::Server* running = nullptr;
+
+  void handle_signal(int) {
+    if (running) running->stop();
+  }
+}  // namespace
+
+int serve(int argc, char** argv) {
+  cxxopts::Options options("Smeagle serve", "Answer ABI queries over a Unix domain socket.");
+
+  std::string socket_path = "smeagle.sock";
+  size_t cache_size = 64;
+
+  // clang-format off
+  options.add_options()
+    ("h,help", "Show help")
+    ("s,socket", "Path of the socket to listen on",
+     cxxopts::value(socket_path)->default_value("smeagle.sock"))
+    ("c,cache", "Number of libraries to keep warm", cxxopts::value(cache_size)->default_value("64"))
+  ;
+  // clang-format on
+
+  auto result = options.parse(argc, argv);
+
+  if (result["help"].as<bool>()) {
+    std::cout << options.help() << std::endl;
+    return 0;
+  }
+
+  smeagle::Server server(socket_path, cache_size);
+  running = &server;
+  std::signal(SIGINT, handle_signal);
+  std::signal(SIGTERM, handle_signal);
+
+  std::cerr << "Listening on " << socket_path << "\n";
+  server.run();
+  running = nullptr;
+  return 0;
+}
@@ -0,0 +1,94 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <smeagle/watch.h>
+
+#include <chrono>
+#include <csignal>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <string>
+
+#include "commands.hpp"
+
+namespace {
+  smeagle::Watcher* running = nullptr;
+
+  void handle_signal(int) {
+    if (running) running->stop();
+  }
+
+  // Print one event, with the ABI diff of a changed library on stdout
+  void report(smeagle::watch_event const& event) {
+    using kind = smeagle::watch_event::kind;
+    switch (event.what) {
+      case kind::added:
+        std::cerr << event.library << ": added\n";
+        break;
+      case kind::removed:
+        std::cerr << event.library << ": removed\n";
+        break;
+      case kind::failed:
+        std::cerr << event.library << ": " << event.error << "\n";
+        break;
+      case kind::changed:
+        if (event.diff.empty()) {
+          std::cerr << event.library << ": relinked, the ABI did not change\n";
+        } else {
+          std::cerr << event.library << ": the ABI changed\n";
+          event.diff.toJson(std::cout);
+        }
+        break;
+    }
+  }
+}  // namespace
+
+int watch(int argc, char** argv) {
+  cxxopts::Options options("Smeagle watch",
+                           "Parse the libraries of a build tree again as they are relinked.");
+  options.positional_help("<directory>");
+
+  std::string root;
+  size_t debounce = 500;
+
+  // clang-format off
+  options.add_options()
+    ("h,help", "Show help")
+    ("d,directory", "Directory to watch", cxxopts::value(root))
+    ("debounce", "Milliseconds a library must be left alone before it is parsed again",
+     cxxopts::value(debounce)->default_value("500"))
+  ;
+  // clang-format on
+  options.parse_positional({"directory"});
+
+  auto result = options.parse(argc, argv);
+
+  if (result["help"].as<bool>() || root.empty()) {
+    std::cout << options.help() << std::endl;
+    return root.empty() && !result["help"].as<bool>();
+  }
+
+  smeagle::Watcher watcher(root, std::chrono::milliseconds(debounce));
+  for (auto const& event : watcher.baseline()) {
+    if (event.what == smeagle::watch_event::kind::failed) {
+      report(event);
+    }
+  }
+  std::cerr << "Watching " << watcher.baseline().size() << " libraries under " << root << "\n";
+
+  running = &watcher;
+  std::signal(SIGINT, handle_signal);
+  std::signal(SIGTERM, handle_signal);
+
+  // Only stop can make an unbounded wait return without events
+  for (auto events = watcher.wait(std::chrono::milliseconds(-1)); !events.empty();
+       events = watcher.wait(std::chrono::milliseconds(-1))) {
+    for (auto const& event : events) {
+      report(event);
+    }
+  }
+  running = nullptr;
+  return 0;
+}
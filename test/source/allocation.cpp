@@ -18,7 +18,8 @@ auto const& get_one(smeagle::Corpus const& corpus, char const* name) {
 }
 
 namespace {
-  auto corpus = smeagle::Smeagle("liballocation.so").parse();
+  smeagle::Smeagle library("liballocation.so");
+  auto corpus = library.parse();
 }
 
 TEST_CASE("Register Allocation - Integral Types") {
@@ -0,0 +1,28 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <doctest/doctest.h>
+
+#include <string>
+
+#include "smeagle/archive.h"
+
+TEST_CASE("Static archives") {
+  CHECK(smeagle::ar::has_magic("liballocation_static.a"));
+  CHECK_FALSE(smeagle::ar::has_magic("liballocation.so"));
+
+  smeagle::ArchiveCorpus archive("liballocation_static.a");
+  REQUIRE(archive.getMembers().size() == 1);
+  auto const &member = archive.getMembers().front().name;
+  CHECK(member.find("allocation") != std::string::npos);
+
+  // The members are relocatable objects, their global functions are the interface
+  auto const &corpus = archive.parse();
+  CHECK(archive.getErrors().empty());
+  REQUIRE_FALSE(corpus.getFunctions().empty());
+  for (auto const &f : corpus.getFunctions()) {
+    CHECK(f.member == member);
+  }
+}
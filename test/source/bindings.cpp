@@ -0,0 +1,38 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <doctest/doctest.h>
+
+#include <vector>
+
+#include "smeagle/bindings.h"
+#include "smeagle/closure.h"
+
+TEST_CASE("Offline symbol binding") {
+  smeagle::Closure closure(smeagle::resolveDependencies("liballocation.so"));
+  closure.parse();
+  REQUIRE(closure.getErrors().empty());
+
+  auto const &graph = closure.getGraph();
+  std::vector<smeagle::Corpus const *> scope;
+  for (auto const &library : graph.libraries) {
+    scope.push_back(&closure.getCorpora().at(library));
+  }
+  auto const &root = *scope.front();
+  CHECK_FALSE(root.getImports().empty());
+
+  // Everything the library needs (except weak references) comes from its dependencies
+  smeagle::SymbolResolver resolver(scope);
+  for (auto const &binding : resolver.resolve(root)) {
+    auto const &import = binding.symbol;
+    CAPTURE(import);
+    if (binding.provider.empty()) {
+      CHECK(binding.problems.front().find("weak") != std::string::npos);
+    } else {
+      CHECK(binding.provider != graph.root);
+      CHECK(binding.problems.empty());
+    }
+  }
+}
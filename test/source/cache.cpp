@@ -0,0 +1,46 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <doctest/doctest.h>
+
+#include <filesystem>
+#include <string>
+
+#include "smeagle/cache.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+  bool has_function(smeagle::Corpus const& corpus, std::string const& name) {
+    for (auto const& f : corpus.getFunctions()) {
+      if (f.function_name == name) return true;
+    }
+    return false;
+  }
+}  // namespace
+
+TEST_CASE("A library rebuilt while its entry is held is parsed again") {
+  auto const root = fs::temp_directory_path() / "smeagle-cache-test";
+  fs::remove_all(root);
+  fs::create_directories(root);
+  auto const library = (root / "libcached.so").string();
+  fs::copy_file("liballocation.so", library);
+
+  smeagle::CorpusCache cache(4);
+  auto const held = cache.get(library);
+  REQUIRE(has_function(held->corpus(), "test_bool"));
+  CHECK(cache.get(library) == held);
+
+  // The held entry keeps the old Symtab open, which Dyninst would hand out again for the path
+  fs::copy_file("libdirectionality.so", library, fs::copy_options::overwrite_existing);
+  auto const rebuilt = cache.get(library);
+  CHECK(rebuilt != held);
+  CHECK(cache.stats().invalidations == 1);
+  CHECK_FALSE(rebuilt->corpus().getFunctions().empty());
+  CHECK_FALSE(has_function(rebuilt->corpus(), "test_bool"));
+  CHECK(has_function(held->corpus(), "test_bool"));
+
+  fs::remove_all(root);
+}
@@ -0,0 +1,65 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <string>
+
+#include "smeagle/closure.h"
+#include "smeagle/smeagle.h"
+
+TEST_CASE("Dependency closure") {
+  auto const graph = smeagle::resolveDependencies("liballocation.so");
+
+  // The test libraries are C++, so at least the C library is loaded
+  REQUIRE(graph.libraries.size() > 1);
+  CHECK(graph.libraries.front() == graph.root);
+  CHECK(graph.missing.empty());
+  auto const &needed = graph.needed.at(graph.root);
+  CHECK(std::any_of(needed.begin(), needed.end(), [](std::string const &library) {
+    return library.find("libc.so") != std::string::npos;
+  }));
+}
+
+TEST_CASE("Shared type classifications") {
+  smeagle::TypeCache cache;
+  CHECK(smeagle::TypeCache::active() == nullptr);
+  {
+    smeagle::TypeCache::Scope scope(&cache);
+    CHECK(smeagle::TypeCache::active() == &cache);
+  }
+  CHECK(smeagle::TypeCache::active() == nullptr);
+
+  CHECK_FALSE(cache.find("x86_64:Struct:point:16"));
+  cache.insert("x86_64:Struct:point:16", {1, 2});
+  auto const hit = cache.find("x86_64:Struct:point:16");
+  REQUIRE(hit);
+  CHECK(hit->lo == 1);
+  CHECK(cache.hits() == 1);
+  CHECK(cache.misses() == 1);
+}
+
+TEST_CASE("Types of the same name and size are classified by their layout") {
+  // Both libraries share one cache, like the libraries of a closure
+  smeagle::TypeCache cache;
+  auto location = [&cache](char const *library) {
+    smeagle::Smeagle smeagle(library);
+    smeagle.setTypeCache(&cache);
+    auto const corpus = smeagle.parse();
+    std::string found;
+    for (auto const &f : corpus.getFunctions()) {
+      if (f.function_name == "test_pair") found = f.parameters.at(0).location();
+    }
+    smeagle.close();
+    return found;
+  };
+
+  CHECK(location("liblayout_integer.so") == "%rdi");
+  CHECK(location("liblayout_floating.so") == "%xmm0");
+  CHECK(location("liblayout_integer.so") == "%rdi");
+  CHECK(cache.size() == 2);
+  CHECK(cache.hits() > 0);
+}
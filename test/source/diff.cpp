@@ -0,0 +1,34 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <doctest/doctest.h>
+
+#include <sstream>
+#include <string>
+
+#include "smeagle/diff.h"
+#include "smeagle/smeagle.h"
+
+TEST_CASE("Corpus Diff") {
+  // The corpora refer to the types of their libraries, which must stay open
+  smeagle::Smeagle allocation_library("liballocation.so");
+  smeagle::Smeagle directionality_library("libdirectionality.so");
+  auto allocation = allocation_library.parse();
+  auto directionality = directionality_library.parse();
+
+  SUBCASE("A corpus does not differ from itself") {
+    CHECK(smeagle::diff(allocation, allocation).empty());
+  }
+
+  SUBCASE("Symbols only in one corpus are added or removed") {
+    auto const d = smeagle::diff(allocation, directionality);
+    CHECK_FALSE(d.added.empty());
+    CHECK_FALSE(d.removed.empty());
+
+    std::ostringstream out;
+    d.toJson(out);
+    CHECK(out.str().find("\"removed\"") != std::string::npos);
+  }
+}
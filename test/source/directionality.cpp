@@ -8,7 +8,8 @@
 #include "smeagle/smeagle.h"
 
 TEST_CASE("Parameter Directionality") {
-  auto corpus = smeagle::Smeagle("libdirectionality.so").parse();
+  smeagle::Smeagle library("libdirectionality.so");
+  auto corpus = library.parse();
 
   auto funcs = corpus.getFunctions();
 
@@ -0,0 +1,55 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <doctest/doctest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include "smeagle/layer.h"
+
+namespace {
+  // A ustar header (the reader does not check the checksum)
+  std::string tar_header(std::string const& name, char type, std::string const& octal_size) {
+    std::string header(512, '\0');
+    header.replace(0, name.size(), name);
+    header.replace(124, octal_size.size(), octal_size);
+    header[156] = type;
+    header.replace(257, 5, "ustar");
+    return header;
+  }
+
+  std::string write_layer(std::string const& name, std::string const& contents) {
+    std::ofstream(name, std::ios::binary) << contents;
+    return name;
+  }
+}  // namespace
+
+TEST_CASE("Corrupt layer headers") {
+  auto const end = std::string(1024, '\0');
+
+  SUBCASE("A pax record length that is not a number is ignored") {
+    auto records = std::string("xyz path=/lib/libfoo.so\n");
+    records.resize(512, '\0');
+    auto const layer = write_layer("layer-pax.tar",
+                                   tar_header("pax", 'x', "00000000030") + records + end);
+    smeagle::LayerCorpus corpus(layer);
+    CHECK_NOTHROW(corpus.parse());
+    CHECK(corpus.size() == 0);
+    std::remove(layer.c_str());
+  }
+
+  SUBCASE("A member larger than the layer is truncated, not allocated") {
+    auto start = std::string("\x7f" "ELF");
+    start.resize(512, '\0');
+    auto const layer = write_layer(
+        "layer-size.tar", tar_header("lib/libhuge.so", '0', "77777777777") + start + end);
+    smeagle::LayerCorpus corpus(layer);
+    CHECK_THROWS_AS(corpus.parse(), std::runtime_error);
+    std::remove(layer.c_str());
+  }
+}
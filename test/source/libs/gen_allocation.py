@@ -179,7 +179,8 @@ auto const& get_one(smeagle::Corpus const& corpus, char const* name) {
 }
 
 namespace {
-  auto corpus = smeagle::Smeagle("liballocation.so").parse();
+  smeagle::Smeagle library("liballocation.so");
+  auto corpus = library.parse();
 }
 
 """
@@ -0,0 +1,13 @@
+// A struct with the same name and size, but another layout, in each of two
+// libraries (built from this file with and without LAYOUT_FLOATING)
+#ifdef LAYOUT_FLOATING
+struct Pair {
+  double a, b;
+};
+#else
+struct Pair {
+  long a, b;
+};
+#endif
+
+extern "C" void test_pair(Pair x) {}
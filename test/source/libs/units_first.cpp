@@ -0,0 +1,22 @@
+// The first of two compilation units, which grows with UNITS_GROWN so that
+// everything in the second one moves
+struct Counter {
+  int count;
+};
+
+extern "C" int first_function(Counter c) { return c.count; }
+
+#ifdef UNITS_GROWN
+struct Grown {
+  long padding[4];
+};
+Grown grown_variable;
+
+extern "C" int first_added(int a, int b) {
+  int x = a;
+  for (int i = 0; i < b; i++) x += i * a;
+  return x;
+}
+#endif
+
+int first_variable = 1;
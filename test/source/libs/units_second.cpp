@@ -0,0 +1,15 @@
+// The second of two compilation units, whose struct is renamed to a name of
+// the same length with UNITS_RENAMED
+#ifdef UNITS_RENAMED
+struct Piont {
+  int x, y;
+};
+extern "C" int second_function(Piont p) { return p.x + p.y; }
+#else
+struct Point {
+  int x, y;
+};
+extern "C" int second_function(Point p) { return p.x + p.y; }
+#endif
+
+int second_variable = 2;
@@ -0,0 +1,227 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "smeagle/batch.h"
+#include "smeagle/decompress.h"
+#include "smeagle/dwarf.h"
+#include "smeagle/elf.h"
+#include "smeagle/scan.h"
+
+namespace fs = std::filesystem;
+
+TEST_CASE("ELF headers") {
+  smeagle::elf::File file("liballocation.so");
+  CHECK(file.is_64bit() == (sizeof(void*) == 8));
+  CHECK(file.find_section(".text") != nullptr);
+  CHECK(file.parse_cost() > 0);
+  CHECK_THROWS_AS(smeagle::elf::File("does-not-exist.so"), std::runtime_error);
+}
+
+TEST_CASE("String tables are read within their bounds") {
+  using namespace std::string_literals;
+  auto const table = "\0.text\0.data"s;  // the last string is not terminated
+  CHECK(smeagle::elf::string_at(table, 1) == ".text");
+  CHECK(smeagle::elf::string_at(table, 0).empty());
+  CHECK(smeagle::elf::string_at(table, 7) == ".data");
+  CHECK(smeagle::elf::string_at(table, table.size()).empty());
+  CHECK(smeagle::elf::string_at(table, ~std::uint64_t{0}).empty());
+}
+
+TEST_CASE("Separate debug files") {
+  smeagle::elf::File stripped("liballocation_stripped.so");
+  CHECK(!stripped.has_dwarf());
+  CHECK(stripped.is_shared_library());
+  CHECK(stripped.debuglink() == "liballocation_stripped.so.debug");
+
+  auto const debug = smeagle::elf::find_debug_file(stripped, {});
+  REQUIRE(fs::path(debug).filename() == "liballocation_stripped.so.debug");
+  smeagle::elf::File debug_file(debug);
+  CHECK(debug_file.has_dwarf());
+  CHECK(!debug_file.is_shared_library());
+
+  // An object with its own DWARF needs no debug file
+  CHECK(smeagle::elf::find_debug_file(smeagle::elf::File("liballocation.so"), {}).empty());
+}
+
+TEST_CASE("Compressed debug sections") {
+  smeagle::elf::File compressed("liballocation_compressed.so");
+  std::vector<char> image;
+  REQUIRE(smeagle::elf::decompress_debug_sections(compressed, image));
+
+  // The units are read from the copy as they are from the uncompressed library
+  smeagle::elf::File decompressed(image.data(), image.size(), compressed.name());
+  CHECK(decompressed.has_dwarf());
+  auto const units = smeagle::dwarf::units(decompressed);
+  auto const expected = smeagle::dwarf::units(smeagle::elf::File("liballocation.so"));
+  REQUIRE(units.size() == expected.size());
+  for (size_t i = 0; i < units.size(); i++) {
+    CHECK(units[i].name == expected[i].name);
+    CHECK(units[i].hash == expected[i].hash);
+  }
+
+  CHECK(!smeagle::elf::decompress_debug_sections(smeagle::elf::File("liballocation.so"), image));
+  CHECK(image.empty());
+}
+
+TEST_CASE("Unit hashes only change with their own unit") {
+  auto hashes = [](char const* library) {
+    std::map<std::string, std::string> found;
+    for (auto const& unit : smeagle::dwarf::units(smeagle::elf::File(library))) {
+      found[fs::path(unit.name).filename().string()] = unit.hash;
+    }
+    REQUIRE(found.count("units_first.cpp") == 1);
+    REQUIRE(found.count("units_second.cpp") == 1);
+    return found;
+  };
+  auto const original = hashes("libunits.so");
+
+  // Growing the first unit moves the code, strings and DIEs of the second
+  auto const grown = hashes("libunits_grown.so");
+  CHECK(grown.at("units_first.cpp") != original.at("units_first.cpp"));
+  CHECK(grown.at("units_second.cpp") == original.at("units_second.cpp"));
+
+  // A rename to a name of the same length keeps every offset
+  auto const renamed = hashes("libunits_renamed.so");
+  CHECK(renamed.at("units_first.cpp") == original.at("units_first.cpp"));
+  CHECK(renamed.at("units_second.cpp") != original.at("units_second.cpp"));
+}
+
+TEST_CASE("Install tree scan") {
+  auto const root = fs::temp_directory_path() / "smeagle-scan-test";
+  fs::remove_all(root);
+  fs::create_directories(root / "lib");
+  fs::copy_file("liballocation.so", root / "lib" / "liballocation.so");
+  fs::create_symlink("liballocation.so", root / "lib" / "liballocation.so.1");
+  std::ofstream(root / "lib" / "notelf.so") << "not a library\n";
+
+  auto const result = smeagle::scan(root.string());
+  auto const library = (root / "lib" / "liballocation.so").string();
+
+  // The symlink is the same inode, and text files are not libraries
+  REQUIRE(result.libraries.size() == 1);
+  CHECK(result.libraries[0] == library);
+  CHECK(result.canonical.size() == 2);
+  CHECK(result.canonical.at((root / "lib" / "liballocation.so.1").string()) == library);
+  CHECK(result.corpusName(library).find(".json") != std::string::npos);
+
+  fs::remove_all(root);
+}
+
+TEST_CASE("Batch journal and resume") {
+  auto const root = fs::temp_directory_path() / "smeagle-journal-test";
+  fs::remove_all(root);
+  fs::create_directories(root);
+  auto const good = (root / "good.json").string();
+  std::vector<smeagle::batch_item> items{{"liballocation.so", good},
+                                         {"does-not-exist.so", (root / "bad.json").string()}};
+
+  smeagle::batch_options options;
+  options.journal = (root / "journal.tsv").string();
+  auto outcomes = smeagle::runBatch(items, options);
+  REQUIRE(outcomes.size() == 2);
+  CHECK(outcomes[0].ok);
+  CHECK_FALSE(outcomes[1].ok);
+
+  // A finished library is not parsed again, a failed one is retried
+  std::ofstream(good) << "kept\n";
+  options.resume = true;
+  outcomes = smeagle::runBatch(items, options);
+  CHECK(outcomes[0].ok);
+  CHECK_FALSE(outcomes[1].ok);
+  std::string kept;
+  std::ifstream(good) >> kept;
+  CHECK(kept == "kept");
+
+  fs::remove_all(root);
+}
+
+TEST_CASE("Resuming after a torn journal line") {
+  auto const root = fs::temp_directory_path() / "smeagle-torn-journal-test";
+  fs::remove_all(root);
+  fs::create_directories(root);
+  auto const good = (root / "good.json").string();
+  auto const bad = (root / "bad.json").string();
+  std::vector<smeagle::batch_item> items{{"liballocation.so", good}, {"does-not-exist.so", bad}};
+
+  // A status we do not know is not done, and the last record was cut short
+  smeagle::batch_options options;
+  options.journal = (root / "journal.tsv").string();
+  options.resume = true;
+  std::ofstream(good) << "kept\n";
+  std::ofstream(options.journal) << "bogus\tliballocation.so\t" << good << "\t\n"
+                                 << "failed\tdoes-not-exist.so\t" << bad << "\tgone\n"
+                                 << "ok\tdoes-not";
+  auto const outcomes = smeagle::runBatch(items, options);
+  REQUIRE(outcomes.size() == 2);
+  CHECK(outcomes[0].ok);
+  CHECK_FALSE(outcomes[1].ok);
+  std::string first;
+  std::ifstream(good) >> first;
+  CHECK(first != "kept");
+
+  // Every line is a whole record, none glued onto the torn one
+  std::ifstream journal(options.journal);
+  size_t records = 0;
+  for (std::string line; std::getline(journal, line); records++) {
+    CHECK(std::count(line.begin(), line.end(), '\t') == 3);
+    CHECK(line.rfind("ok\tdoes-not", 0) != 0);
+  }
+  CHECK(records == 4);
+
+  fs::remove_all(root);
+}
+
+TEST_CASE("Scan shards merge back into the whole scan") {
+  auto const root = fs::temp_directory_path() / "smeagle-shard-test";
+  fs::remove_all(root);
+  fs::create_directories(root);
+  fs::copy_file("liballocation.so", root / "liballocation.so");
+  fs::copy_file("libdirectionality.so", root / "libdirectionality.so");
+  fs::create_symlink("liballocation.so", root / "liballocation.so.1");
+
+  auto const whole = smeagle::scan(root.string());
+  REQUIRE(whole.libraries.size() == 2);
+  std::map<std::string, std::string> const errors{{whole.libraries[0], "failed"}};
+  std::stringstream expected;
+  whole.toJson(expected, errors, true);
+
+  // Every library is in exactly one shard, with its paths
+  smeagle::ScanResult merged;
+  std::map<std::string, std::string> merged_errors;
+  for (size_t i = 0; i < 2; i++) {
+    auto const part = whole.shard(i, 2);
+    CHECK(part.libraries.size() == 1);
+    std::map<std::string, std::string> part_errors;
+    for (auto const& library : part.libraries) {
+      if (errors.count(library)) part_errors[library] = errors.at(library);
+    }
+    std::stringstream index;
+    part.toJson(index, part_errors, true);
+    merged.merge(smeagle::readIndex(index, &merged_errors));
+  }
+
+  std::stringstream actual;
+  merged.toJson(actual, merged_errors, true);
+  CHECK(actual.str() == expected.str());
+  CHECK_THROWS_AS(whole.shard(2, 2), std::runtime_error);
+
+  fs::remove_all(root);
+}
+
+TEST_CASE("A deeply nested index is rejected") {
+  std::stringstream index("{\"corpora\": " + std::string(100000, '['));
+  CHECK_THROWS_AS(smeagle::readIndex(index), std::runtime_error);
+}
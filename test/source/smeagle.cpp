@@ -4,10 +4,19 @@
 // SPDX-License-Identifier: (Apache-2.0 OR MIT)
 
 #include <doctest/doctest.h>
+#include <smeagle/diff.h>
+#include <smeagle/dwarf.h>
 #include <smeagle/smeagle.h>
+#include <smeagle/unit_cache.h>
 #include <smeagle/version.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 TEST_CASE("Smeagle") {
   using namespace smeagle;
@@ -18,6 +27,239 @@ TEST_CASE("Smeagle") {
   // CHECK(smeagle.parse(FormatCode::Json) == "Hallo 1!");
 }
 
+TEST_CASE("Symbol errors are quarantined") {
+  smeagle::Smeagle library("liballocation.so");
+  auto corpus = library.parse();
+  CHECK(corpus.getErrors().empty());
+
+  smeagle::Stats stats;
+  std::ostringstream out;
+  corpus.toJson(out, &stats);
+  CHECK(out.str().find("\"errors\":") != std::string::npos);
+  CHECK(stats.get(smeagle::Counter::Errors) == 0);
+}
+
+TEST_CASE("A cancelled parse keeps a truncated corpus") {
+  smeagle::CancellationToken token;
+  CHECK_FALSE(token.stopRequested());
+  token.cancel();
+  CHECK(token.stopRequested());
+
+  smeagle::Smeagle smeagle("liballocation.so");
+  smeagle.setCancellation(&token);
+  auto corpus = smeagle.parse();
+  CHECK(corpus.isTruncated());
+  CHECK(corpus.getFunctions().empty());
+
+  std::ostringstream out;
+  corpus.toJson(out, nullptr, &token);
+  CHECK(out.str().find("\"truncated\": true") != std::string::npos);
+
+  smeagle::CancellationToken expired;
+  expired.setTimeout(std::chrono::milliseconds(0));
+  CHECK(expired.stopRequested());
+}
+
+TEST_CASE("A parse stopped halfway writes what it described") {
+  smeagle::Smeagle library("liballocation.so");
+  auto const whole = library.parse();
+
+  smeagle::CancellationToken token;
+  token.setCheckLimit(32);
+  smeagle::Smeagle smeagle("liballocation.so");
+  smeagle.setCancellation(&token);
+  auto const corpus = smeagle.parse();
+  CHECK(token.stopRequested());
+  CHECK(corpus.isTruncated());
+  CHECK_FALSE(corpus.getFunctions().empty());
+  CHECK(corpus.getFunctions().size() < whole.getFunctions().size());
+
+  // The token stays set, which must not keep the locations out of the json
+  std::ostringstream out;
+  corpus.toJson(out);
+  CHECK(out.str().find("\"function\"") != std::string::npos);
+  CHECK(out.str().find("\"truncated\": true") != std::string::npos);
+
+  // The same when streaming a unit at a time
+  smeagle::CancellationToken streaming;
+  streaming.setCheckLimit(32);
+  smeagle::Smeagle streamed("liballocation.so");
+  streamed.setCancellation(&streaming);
+  std::ostringstream partial;
+  CHECK_FALSE(streamed.stream(partial));
+  CHECK(partial.str().find("\"function\"") != std::string::npos);
+  CHECK(partial.str().find("\"truncated\": true") != std::string::npos);
+}
+
+TEST_CASE("Load profiles describe the same interface") {
+  for (auto const* library : {"liballocation.so", "libdirectionality.so"}) {
+    CAPTURE(library);
+    std::ostringstream minimal, full;
+    smeagle::Stats stats;
+
+    // Each library is closed before the other profile opens it again
+    smeagle::Smeagle lean(library);
+    lean.setStats(&stats);
+    lean.parse().toJson(minimal);
+    lean.close();
+    CHECK(stats.calls(smeagle::Phase::Types) == 1);
+
+    smeagle::Smeagle everything(library);
+    everything.setLoadProfile(smeagle::LoadProfile::Full);
+    everything.parse().toJson(full);
+    everything.close();
+
+    auto const a = smeagle::Corpus::fromJson(minimal.str());
+    auto const b = smeagle::Corpus::fromJson(full.str());
+    CHECK(!a.getFunctions().empty());
+    CHECK(a.getFunctions().size() == b.getFunctions().size());
+    CHECK(a.getVariables().size() == b.getVariables().size());
+    CHECK(smeagle::diff(a, b).empty());
+    CHECK(minimal.str() == full.str());
+  }
+}
+
+TEST_CASE("Streaming a unit at a time writes the same corpus") {
+  // Units may come in another order, so compare the lines without their commas
+  auto lines = [](std::string const& json) {
+    std::vector<std::string> all;
+    std::istringstream in(json);
+    for (std::string line; std::getline(in, line);) {
+      if (!line.empty() && line.back() == ',') line.pop_back();
+      all.push_back(line);
+    }
+    std::sort(all.begin(), all.end());
+    return all;
+  };
+
+  std::ostringstream parsed, streamed;
+  smeagle::Smeagle whole("liballocation.so");
+  whole.parse().toJson(parsed);
+  whole.close();
+
+  smeagle::Smeagle units("liballocation.so");
+  CHECK(units.stream(streamed, std::uint64_t{1} << 20));
+  units.close();
+
+  CHECK(lines(streamed.str()) == lines(parsed.str()));
+}
+
+TEST_CASE("Unchanged compilation units are reused from the unit cache") {
+  smeagle::elf::File file("liballocation.so");
+  auto const units = smeagle::dwarf::units(file);
+  REQUIRE(!units.empty());
+  CHECK(units.front().hash.size() == 32);
+
+  std::ostringstream first, second;
+  smeagle::UnitCache cache;
+  smeagle::Smeagle parsed("liballocation.so");
+  parsed.setUnitCache(&cache);
+  CHECK(parsed.stream(first));
+  parsed.close();
+  CHECK(cache.hits() == 0);
+
+  // The cache is read back from a file in practice
+  std::stringstream saved;
+  cache.save(saved);
+  smeagle::UnitCache loaded;
+  loaded.load(saved);
+  CHECK(loaded.size() == cache.size());
+
+  smeagle::Smeagle reused("liballocation.so");
+  reused.setUnitCache(&loaded);
+  CHECK(reused.stream(second));
+  reused.close();
+
+  CHECK(loaded.hits() > 0);
+  CHECK(loaded.misses() == 0);
+  CHECK(second.str() == first.str());
+}
+
+TEST_CASE("A stripped library is described with its debug file") {
+  std::ostringstream whole, stripped;
+  smeagle::Smeagle with_dwarf("liballocation.so");
+  with_dwarf.parse().toJson(whole);
+  with_dwarf.close();
+
+  smeagle::Smeagle without_dwarf("liballocation_stripped.so");
+  without_dwarf.parse().toJson(stripped);
+  without_dwarf.close();
+
+  // Everything but the name of the library
+  auto corpus = [](std::string const& json) { return json.substr(json.find("\"locations\"")); };
+  CHECK(corpus(stripped.str()) == corpus(whole.str()));
+}
+
+TEST_CASE("Compressed debug sections are decompressed before opening") {
+  std::ostringstream plain, compressed;
+  smeagle::Smeagle uncompressed("liballocation.so");
+  uncompressed.parse().toJson(plain);
+  uncompressed.close();
+
+  smeagle::Stats stats;
+  smeagle::Smeagle decompressed("liballocation_compressed.so");
+  decompressed.setStats(&stats);
+  decompressed.parse().toJson(compressed);
+  decompressed.close();
+
+  auto corpus = [](std::string const& json) { return json.substr(json.find("\"locations\"")); };
+  CHECK(corpus(compressed.str()) == corpus(plain.str()));
+  CHECK(stats.calls(smeagle::Phase::Decompress) == 1);
+}
+
+TEST_CASE("A library opened twice stays open until both are closed") {
+  smeagle::Smeagle first("liballocation.so");
+  auto const corpus = first.parse();
+  {
+    // Dyninst hands this one the same Symtab, which it must not close
+    smeagle::Smeagle second("liballocation.so");
+    CHECK(second.parse().getFunctions().size() == corpus.getFunctions().size());
+  }
+
+  // Writing the corpus reads the types of the Symtab
+  std::ostringstream out;
+  corpus.toJson(out);
+  CHECK(out.str().find("\"test_bool\"") != std::string::npos);
+}
+
+TEST_CASE("A corpus is read back from its json") {
+  for (auto const* library : {"liballocation.so", "libdirectionality.so"}) {
+    smeagle::Smeagle smeagle(library);
+    auto const parsed = smeagle.parse();
+    std::ostringstream written;
+    parsed.toJson(written);
+
+    auto const loaded = smeagle::Corpus::fromJson(written.str());
+    CHECK(loaded.getLibrary() == parsed.getLibrary());
+    CHECK(loaded.getFunctions().size() == parsed.getFunctions().size());
+    CHECK(loaded.getExports().size() == parsed.getExports().size());
+    CHECK(smeagle::diff(parsed, loaded).empty());
+
+    std::ostringstream rewritten;
+    loaded.toJson(rewritten);
+    CHECK(rewritten.str() == written.str());
+    smeagle.close();
+  }
+
+  CHECK_THROWS_AS(smeagle::Corpus::fromJson("{\"library\": \"lib.so\", \"locations\": ["),
+                  std::runtime_error);
+  CHECK_THROWS_AS(smeagle::Corpus::fromJson("{}"), std::runtime_error);
+}
+
+TEST_CASE("Archive member names are escaped in the json") {
+  smeagle::Smeagle smeagle("liballocation.so");
+  smeagle::Corpus archive("libarchive.a");
+  archive.merge(smeagle.parse(), "odd \"name\\.o");
+  REQUIRE(!archive.getFunctions().empty());
+  std::ostringstream written;
+  archive.toJson(written);
+
+  auto const loaded = smeagle::Corpus::fromJson(written.str());
+  REQUIRE(loaded.getFunctions().size() == archive.getFunctions().size());
+  CHECK(loaded.getFunctions().front().member == "odd \"name\\.o");
+  smeagle.close();
+}
+
 // TEST_CASE("Smeagle version") {
 //  static_assert(std::string_view(SMEAGLE_VERSION) == std::string_view("1.0"));
 //  CHECK(std::string(SMEAGLE_VERSION) == std::string("1.0"));
@@ -0,0 +1,43 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <doctest/doctest.h>
+#include <smeagle/stats.h>
+
+#include <sstream>
+#include <string>
+
+TEST_CASE("Stats") {
+  using namespace smeagle;
+
+  SUBCASE("Timers without stats are a no-op") { PhaseTimer timer(nullptr, Phase::Open); }
+
+  SUBCASE("Timers record one call per scope") {
+    Stats stats;
+    { PhaseTimer timer(&stats, Phase::Classify); }
+    { PhaseTimer timer(&stats, Phase::Classify); }
+    CHECK(stats.calls(Phase::Classify) == 2);
+    CHECK(stats.calls(Phase::Open) == 0);
+    CHECK(stats.wallTime(Phase::Classify).count() >= 0);
+  }
+
+  SUBCASE("Counters accumulate") {
+    Stats stats;
+    stats.add(Counter::Functions);
+    stats.add(Counter::Functions, 4);
+    CHECK(stats.get(Counter::Functions) == 5);
+    CHECK(stats.get(Counter::Bytes) == 0);
+  }
+
+  SUBCASE("Json report has every phase and counter") {
+    Stats stats;
+    stats.add(Counter::Symbols, 3);
+    std::ostringstream out;
+    stats.toJson(out);
+    auto const json = out.str();
+    CHECK(json.find("\"serialize\"") != std::string::npos);
+    CHECK(json.find("\"symbols\": 3") != std::string::npos);
+  }
+}
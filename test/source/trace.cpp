@@ -0,0 +1,37 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <doctest/doctest.h>
+#include <smeagle/trace.h>
+
+#include <sstream>
+#include <string>
+
+TEST_CASE("Trace") {
+  using namespace smeagle;
+
+  trace::clear();
+
+  SUBCASE("Spans are not recorded unless started") {
+    { trace::Span span("load", "not-recorded"); }
+    std::ostringstream out;
+    trace::write(out);
+    CHECK(out.str().find("not-recorded") == std::string::npos);
+  }
+
+  SUBCASE("Spans are written as complete events") {
+    trace::start();
+    { trace::Span span("load", "open", "lib\"quoted\".so"); }
+    trace::stop();
+    std::ostringstream out;
+    trace::write(out);
+    auto const json = out.str();
+    CHECK(json.find("\"name\":\"open\"") != std::string::npos);
+    CHECK(json.find("\"ph\":\"X\"") != std::string::npos);
+    CHECK(json.find("lib\\\"quoted\\\".so") != std::string::npos);
+  }
+
+  trace::clear();
+}
@@ -0,0 +1,47 @@
+// Copyright 2013-2021 Lawrence Livermore National Security, LLC and other
+// Spack Project Developers. See the top-level COPYRIGHT file for details.
+//
+// SPDX-License-Identifier: (Apache-2.0 OR MIT)
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <filesystem>
+
+#include "smeagle/watch.h"
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+TEST_CASE("Watching a build tree") {
+  auto const root = fs::temp_directory_path() / "smeagle-watch-test";
+  fs::remove_all(root);
+  fs::create_directories(root / "lib");
+  fs::copy_file("liballocation.so", root / "lib" / "libwatched.so");
+
+  smeagle::Watcher watcher(root.string(), 50ms);
+  REQUIRE(watcher.baseline().size() == 1);
+  CHECK(watcher.baseline().front().what == smeagle::watch_event::kind::added);
+  auto const library = watcher.baseline().front().library;
+
+  // Nothing happens until something is written
+  CHECK(watcher.wait(100ms).empty());
+
+  // Relink it as another library, the way linkers do: write elsewhere, then rename
+  fs::copy_file("libdirectionality.so", root / "lib" / "libwatched.so.tmp");
+  fs::rename(root / "lib" / "libwatched.so.tmp", root / "lib" / "libwatched.so");
+  auto events = watcher.wait(5s);
+  REQUIRE(events.size() == 1);
+  CHECK(events.front().library == library);
+  CHECK(events.front().what == smeagle::watch_event::kind::changed);
+  CHECK(!events.front().diff.empty());
+
+  fs::remove(root / "lib" / "libwatched.so");
+  events = watcher.wait(5s);
+  REQUIRE(events.size() == 1);
+  CHECK(events.front().what == smeagle::watch_event::kind::removed);
+
+  watcher.stop();
+  CHECK(watcher.wait(-1ms).empty());
+  fs::remove_all(root);
+}